@@ -0,0 +1,137 @@
+#include "../../include/markdown-abstract-math.hpp"
+#include "../../include/markdown-math.hpp"
+#include "../../include/markdown-quickjs-math.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+using expressions_t = std::vector<Markdown::AbstractMath::expression_t>;
+
+using factory_t = std::function<std::unique_ptr<Markdown::AbstractMath>()>;
+
+// Returns the bytes an engine's JavaScript heap takes
+using memory_t = std::function<std::size_t(Markdown::AbstractMath&)>;
+
+using clock_type = std::chrono::steady_clock;
+
+// Returns the $...$ and $$...$$ equations of a markdown file
+expressions_t read_equations(const std::string& path)
+{
+	std::ifstream file(path);
+
+	std::string markdown{std::istreambuf_iterator<char>{file},
+						 std::istreambuf_iterator<char>{}};
+
+	std::regex equation(R"(\$\$([^$]+)\$\$|\$([^$]+)\$)");
+
+	expressions_t expressions;
+
+	std::sregex_iterator match(markdown.begin(), markdown.end(), equation);
+
+	for (std::sregex_iterator end; match != end; ++match)
+	{
+		if ((*match)[1].matched) expressions.emplace_back((*match)[1], true);
+
+		else expressions.emplace_back((*match)[2], false);
+	}
+
+	return expressions;
+}
+
+double milliseconds(clock_type::duration duration)
+{
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+void run(const std::string& name,
+		 const factory_t& create,
+		 const memory_t& memory,
+		 const expressions_t& expressions,
+		 std::size_t rounds)
+{
+	auto start = clock_type::now();
+
+	auto engine = create();
+
+	auto created = clock_type::now();
+
+	// Render faulty equations in the error-color, quietly
+	engine->configure("throw-on-error", false);
+
+	engine->configure("log-errors", false);
+
+	for (std::size_t round = 0; round < rounds; ++round)
+	{
+		for (const auto& expression : expressions)
+		{
+			engine->render(expression.first, expression.second);
+		}
+	}
+
+	auto rendered = clock_type::now();
+
+	auto seconds = milliseconds(rendered - created) / 1000;
+
+	std::cout << std::left << std::setw(10) << name << std::right
+			  << std::fixed << std::setprecision(1)
+			  << std::setw(12) << milliseconds(created - start)
+			  << std::setw(16) << expressions.size() * rounds / seconds
+			  << std::setw(12) << memory(*engine) / (1024.0 * 1024.0)
+			  << "\n";
+}
+
+int main(int argc, const char* argv[])
+{
+	// Usage: benchmark [rounds] [markdown] [katex folder]
+	std::size_t rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10;
+
+	auto expressions = read_equations(argc > 2 ? argv[2] : "../math/test.md");
+
+	std::string katex = argc > 3 ? argv[3] : "../../katex";
+
+	std::cout << expressions.size() << " equations, " << rounds << " rounds\n\n"
+			  << std::left << std::setw(10) << "engine" << std::right
+			  << std::setw(12) << "start (ms)"
+			  << std::setw(16) << "equations/s"
+			  << std::setw(12) << "heap (MiB)"
+			  << "\n";
+
+	run("v8",
+		[&katex] {
+			std::unique_ptr<Markdown::AbstractMath> math =
+				std::make_unique<Markdown::Math>(katex);
+
+			return math;
+		},
+		[] (Markdown::AbstractMath& math) {
+			return static_cast<Markdown::Math&>(math).heap_statistics().used;
+		},
+		expressions,
+		rounds);
+
+#ifdef MARKDOWNPP_QUICKJS
+	run("quickjs",
+		[&katex] {
+			std::unique_ptr<Markdown::AbstractMath> math =
+				std::make_unique<Markdown::QuickJSMath>(katex);
+
+			return math;
+		},
+		[] (Markdown::AbstractMath& math) {
+			return static_cast<Markdown::QuickJSMath&>(math).memory_usage();
+		},
+		expressions,
+		rounds);
+#else
+	std::cout << "\n(build with `make QUICKJS=1` to compare with QuickJS)\n";
+#endif
+}
@@ -11,6 +11,9 @@
 
 #include "markdown-configurable.hpp"
 
+#include <cstddef>
+#include <string>
+
 namespace Markdown
 {
 	/***********************************************************************//*!
@@ -62,6 +65,25 @@ namespace Markdown
 		***********************************************************************/
 		
 		virtual std::string render(const std::string& markdown) = 0;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Renders markdown to HTML.
+		*
+		*	@details Allows engines to render directly from a view of the
+		*			 markdown (e.g. a memory-mapped file), without copying
+		*			 it first. The default implementation copies the
+		*			 markdown into a string and calls render(std::string).
+		*
+		*	@param markdown A pointer to the markdown (not null-terminated).
+		*
+		*	@param size The size of the markdown.
+		*
+		*	@return The same as render(const std::string&).
+		*
+		***********************************************************************/
+		
+		virtual std::string render(const char* markdown, std::size_t size);
 
 		/*******************************************************************//*!
 		*
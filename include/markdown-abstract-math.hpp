@@ -10,6 +10,11 @@
 #define MARKDOWN_ABSTRACT_MATH_HPP
 
 #include "markdown-configurable.hpp"
+#include "markdown-deadline.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace Markdown
 {
@@ -60,6 +65,78 @@ namespace Markdown
 		
 		virtual std::string render(const std::string& expression,
 								   bool display_math) = 0;
+		
+		/*! A LaTeX expression and whether to use display-math for it. */
+		using expression_t = std::pair<std::string, bool>;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Renders many expressions to HTML.
+		*
+		*	@details Engines that can render expressions in parallel (or
+		*			 more cheaply in bulk) override this method. The default
+		*			 renders the expressions one after another.
+		*
+		*	@param expressions The expressions to render.
+		*
+		*	@return The HTML for each expression, in the same order.
+		*
+		***********************************************************************/
+		
+		virtual std::vector<std::string>
+		render(const std::vector<expression_t>& expressions);
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Identifies the engine's implementation.
+		*
+		*	@details Two engines with equal fingerprints (and settings)
+		*			 render every expression to the same HTML, such that
+		*			 the HTML may be cached under the fingerprint.
+		*
+		*	@return An identifier of the engine's build (empty by default).
+		*
+		***********************************************************************/
+		
+		virtual std::string fingerprint() const;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Gives the engine a chance to clean up between documents.
+		*
+		*	@details Called by long-running renderers when they are idle,
+		*			 e.g. to collect garbage. Does nothing by default.
+		*
+		***********************************************************************/
+		
+		virtual void idle();
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Sets the Deadline by which renders must finish.
+		*
+		*	@details Engines stop rendering once it expired and render
+		*			 the remaining expressions as errors (in the
+		*			 error-color). Engines wrapping others pass it on.
+		*
+		*	@param deadline The Deadline (by default one that never expires).
+		*
+		***********************************************************************/
+		
+		virtual void deadline(const Deadline& deadline);
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the Deadline by which renders must finish.
+		*
+		***********************************************************************/
+		
+		const Deadline& deadline() const;
+		
+	protected:
+		
+		/*! The Deadline by which renders must finish. */
+		Deadline _deadline;
 	};
 }
 
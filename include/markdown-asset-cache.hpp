@@ -0,0 +1,213 @@
+/***************************************************************************//*!
+*
+*	@file markdown-asset-cache.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_ASSET_CACHE_HPP
+#define MARKDOWN_ASSET_CACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief A process-wide cache for stylesheets, scripts and URLs.
+	*
+	*	@details Assets are cached by their (absolute) path and a kind,
+	*			 which distinguishes the different ways the same file
+	*			 may be included (e.g. embedded or linked). The cached
+	*			 contents are whatever the loader produced, i.e. usually
+	*			 the escaped file contents already wrapped in an HTML tag.
+	*			 An entry is reloaded when the file's device, inode, size
+	*			 or modification time changes, such that edits to themes
+	*			 show up on the next render. All methods are thread-safe.
+	*
+	***************************************************************************/
+
+	class AssetCache
+	{
+	public:
+
+		/*! Produces the contents to cache from the path of an asset. */
+		using loader_t = std::function<std::string(const std::string&)>;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the cache shared by all Parsers in the process.
+		*
+		***********************************************************************/
+
+		static AssetCache& shared();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs an empty AssetCache.
+		*
+		***********************************************************************/
+
+		AssetCache();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-constructor.
+		*
+		***********************************************************************/
+
+		AssetCache(const AssetCache& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-assignment operator.
+		*
+		***********************************************************************/
+
+		AssetCache& operator=(const AssetCache& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Retrieves an asset, loading it on a miss.
+		*
+		*	@details If the file cannot be examined, the loader is called
+		*			 without caching anything (such that it may report
+		*			 the error in its own way).
+		*
+		*	@param path The path of the asset.
+		*
+		*	@param kind The kind of inclusion (e.g. the opening HTML tag).
+		*
+		*	@param loader The function to call on a miss.
+		*
+		*	@return The (possibly cached) result of the loader.
+		*
+		***********************************************************************/
+
+		std::string get(const std::string& path,
+						const std::string& kind,
+						const loader_t& loader);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Checks whether an asset changed since it was cached.
+		*
+		*	@param path The path of the asset.
+		*
+		*	@param kind The kind of inclusion (e.g. the opening HTML tag).
+		*
+		*	@return True if the file changed on disk, could not be examined
+		*			or is not cached (under that kind), else false.
+		*
+		***********************************************************************/
+
+		bool modified(const std::string& path, const std::string& kind) const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Removes all entries (the counters are kept).
+		*
+		***********************************************************************/
+
+		void clear();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the number of entries.
+		*
+		***********************************************************************/
+
+		std::size_t size() const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns how often get() was served from the cache.
+		*
+		***********************************************************************/
+
+		std::size_t hits() const noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns how often get() had to call its loader.
+		*
+		***********************************************************************/
+
+		std::size_t misses() const noexcept;
+
+	private:
+
+		/*! Identifies a particular version of a file. */
+		struct Stamp
+		{
+			bool operator==(const Stamp& other) const noexcept;
+
+			std::size_t device;
+
+			std::size_t inode;
+
+			std::size_t size;
+
+			std::time_t modified;
+
+			/*! The sub-second part of the modification time (if known). */
+			long modified_nanoseconds;
+		};
+
+		/*! A cached asset. */
+		struct Entry
+		{
+			Stamp stamp;
+
+			std::string contents;
+		};
+
+		/*******************************************************************//*!
+		*
+		*	@brief Examines a file.
+		*
+		*	@param path The path of the file.
+		*
+		*	@param stamp The stamp to fill in.
+		*
+		*	@return True if the file could be examined, else false.
+		*
+		***********************************************************************/
+
+		static bool _stamp(const std::string& path, Stamp& stamp);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the key of an entry.
+		*
+		*	@param path The path of the asset.
+		*
+		*	@param kind The kind of inclusion.
+		*
+		***********************************************************************/
+
+		static std::string _key(const std::string& path,
+								const std::string& kind);
+
+		/*! Guards the entries. */
+		mutable std::mutex _mutex;
+
+		/*! The entries, by kind and absolute path. */
+		std::unordered_map<std::string, Entry> _entries;
+
+		/*! The number of cache hits. */
+		std::atomic<std::size_t> _hits;
+
+		/*! The number of cache misses. */
+		std::atomic<std::size_t> _misses;
+	};
+}
+
+#endif /* MARKDOWN_ASSET_CACHE_HPP */
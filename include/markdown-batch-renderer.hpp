@@ -0,0 +1,302 @@
+/***************************************************************************//*!
+*
+*	@file markdown-batch-renderer.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_BATCH_RENDERER_HPP
+#define MARKDOWN_BATCH_RENDERER_HPP
+
+#include "markdown-configurable.hpp"
+#include "markdown-manifest.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Markdown
+{
+	class Parser;
+
+	/***********************************************************************//*!
+	*
+	*	@brief Renders many markdown files to HTML files in parallel.
+	*
+	*	@details Every worker thread constructs its own Parser (and thereby
+	*			 its own markdown and math engines) from a factory. Jobs are
+	*			 sorted by size, dealt out to per-worker queues and, once a
+	*			 worker's own queue is empty, stolen from the other workers.
+	*			 Before rendering a file, a worker reserves the file's size
+	*			 from a shared memory budget and waits while the budget is
+	*			 exhausted (a single job may always run, however large).
+	*			 If a manifest is set, jobs whose input contents and Parser
+	*			 fingerprint match the manifest's entry (and whose output
+	*			 still exists) are skipped, and outputs (inside the output
+	*			 root) whose input has been deleted are deleted as well.
+	*			 Configuration (key : values [default]):
+	*			 + jobs				: (number of workers, 0 = cores) [0]
+	*			 + memory-limit		: (bytes of input in flight) [256 MiB]
+	*
+	***************************************************************************/
+
+	class BatchRenderer : public Configurable
+	{
+	public:
+
+		/*! The default settings for a BatchRenderer. */
+		static const Configurable::settings_t default_settings;
+
+		/*! Creates a configured Parser for a worker. */
+		using factory_t = std::function<std::unique_ptr<Parser>()>;
+
+		/*! The outcome of rendering one file. */
+		struct Result
+		{
+			/*! The path of the markdown file. */
+			std::string input;
+
+			/*! The path of the HTML file. */
+			std::string output;
+
+			/*! Whether the file was rendered successfully (or skipped). */
+			bool success;
+
+			/*! Whether the output was up to date and thus not rendered. */
+			bool skipped;
+
+			/*! The error message if the file could not be rendered. */
+			std::string error;
+		};
+
+		/*! The results of a run, in the order the jobs were added. */
+		using results_t = std::vector<Result>;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a new BatchRenderer.
+		*
+		*	@param factory The factory for the workers' Parsers. Called on
+		*				   the worker threads.
+		*
+		*	@param settings The settings for the BatchRenderer.
+		*
+		***********************************************************************/
+
+		BatchRenderer(const factory_t& factory,
+					  const Configurable::settings_t& settings = default_settings);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Adds a file to render.
+		*
+		*	@details Missing directories of the output path are created.
+		*
+		*	@param input The path of the markdown file.
+		*
+		*	@param output The path of the HTML file.
+		*
+		***********************************************************************/
+
+		void add(const std::string& input, const std::string& output);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Removes all jobs.
+		*
+		***********************************************************************/
+
+		void clear();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the number of jobs.
+		*
+		***********************************************************************/
+
+		std::size_t size() const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Sets the path of the manifest for incremental rebuilds.
+		*
+		*	@param path The path of the manifest file (empty for none).
+		*
+		***********************************************************************/
+
+		void manifest(const std::string& path);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the path of the manifest file (empty for none).
+		*
+		***********************************************************************/
+
+		const std::string& manifest() const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Sets the directory outputs are rendered into.
+		*
+		*	@details Only outputs inside it are deleted along with their
+		*			 inputs (none if it is empty).
+		*
+		*	@param path The path of the directory.
+		*
+		***********************************************************************/
+
+		void output_root(const std::string& path);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the directory outputs are rendered into.
+		*
+		***********************************************************************/
+
+		const std::string& output_root() const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the outputs deleted during the last run.
+		*
+		***********************************************************************/
+
+		const std::vector<std::string>& deleted() const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Renders all jobs and blocks until they are done.
+		*
+		*	@return The result of every job, in the order they were added.
+		*
+		***********************************************************************/
+
+		results_t run();
+
+	private:
+
+		/*! A file to render. */
+		struct Job
+		{
+			/*! The index of the job's result. */
+			std::size_t index;
+
+			/*! The size of the input. */
+			std::size_t size;
+		};
+
+		/*! A worker's queue, which other workers may steal from. */
+		struct Queue
+		{
+			std::mutex mutex;
+
+			std::deque<Job> jobs;
+		};
+
+		/*******************************************************************//*!
+		*
+		*	@brief The main loop of a worker thread.
+		*
+		*	@param worker The index of the worker (and its queue).
+		*
+		*	@param results The results to fill in.
+		*
+		***********************************************************************/
+
+		void _work(std::size_t worker, results_t& results);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Takes the next job for a worker.
+		*
+		*	@details Takes the largest job from the worker's own queue or
+		*			 else steals the smallest job from another queue.
+		*
+		*	@param worker The index of the worker.
+		*
+		*	@param job The job to fill in.
+		*
+		*	@return True if there was a job left, else false.
+		*
+		***********************************************************************/
+
+		bool _next(std::size_t worker, Job& job);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Reserves memory from the budget, waiting if necessary.
+		*
+		*	@param bytes The number of bytes to reserve.
+		*
+		***********************************************************************/
+
+		void _acquire(std::size_t bytes);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns memory to the budget.
+		*
+		*	@param bytes The number of bytes to return.
+		*
+		***********************************************************************/
+
+		void _release(std::size_t bytes);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deletes outputs whose inputs no longer exist.
+		*
+		*	@details Also removes their entries from the manifest. Outputs
+		*			 outside the output root are left alone, as are those
+		*			 recorded with a relative input path (whose existence
+		*			 depends on the working directory).
+		*
+		***********************************************************************/
+
+		void _delete_orphans();
+
+		/*! The factory for the workers' Parsers. */
+		factory_t _factory;
+
+		/*! The (input, output) pairs to render. */
+		std::vector<std::pair<std::string, std::string>> _jobs;
+
+		/*! The path of the manifest file (empty for none). */
+		std::string _manifest_path;
+
+		/*! The directory outputs are rendered into. */
+		std::string _output_root;
+
+		/*! The loaded manifest (during a run). */
+		std::unique_ptr<Manifest> _manifest;
+
+		/*! The new manifest entries of the jobs (during a run). */
+		std::vector<Manifest::Entry> _entries;
+
+		/*! The outputs deleted during the last run. */
+		std::vector<std::string> _deleted;
+
+		/*! The workers' queues (during a run). */
+		std::vector<std::unique_ptr<Queue>> _queues;
+
+		/*! Guards the memory budget. */
+		std::mutex _memory_mutex;
+
+		/*! Signalled when memory is returned to the budget. */
+		std::condition_variable _memory_released;
+
+		/*! The number of bytes currently reserved. */
+		std::size_t _memory_in_use;
+
+		/*! The maximum number of bytes to reserve (during a run). */
+		std::size_t _memory_limit;
+	};
+}
+
+#endif /* MARKDOWN_BATCH_RENDERER_HPP */
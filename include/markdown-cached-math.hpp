@@ -0,0 +1,181 @@
+/***************************************************************************//*!
+*
+*	@file markdown-cached-math.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_CACHED_MATH_HPP
+#define MARKDOWN_CACHED_MATH_HPP
+
+#include "markdown-abstract-math.hpp"
+#include "markdown-math-cache.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief Serves equations from a MathCache, rendering only the misses.
+	*
+	*	@details Wraps another math engine. The cache key of an equation is
+	*			 a hash of the normalized expression (with runs of
+	*			 whitespace collapsed), the display flag, the engine's
+	*			 settings (e.g. all-display-math) and the engine's
+	*			 fingerprint (e.g. the KaTeX version). The misses of a batch
+	*			 are passed on to the engine as one batch (such that a
+	*			 MathPool still renders them in parallel), each distinct
+	*			 equation only once. The CachedMath's settings are those of
+	*			 the engine and are passed on to it before rendering. The
+	*			 engine may be created lazily, on the first miss, such
+	*			 that documents whose equations are all cached (or that
+	*			 have none) need no engine.
+	*
+	***************************************************************************/
+
+	class CachedMath : public AbstractMath
+	{
+	public:
+
+		/*! Creates the engine. */
+		using factory_t = std::function<std::unique_ptr<AbstractMath>()>;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a new CachedMath.
+		*
+		*	@param engine The engine to render misses with.
+		*
+		*	@param cache The cache to use (by default the shared one).
+		*
+		***********************************************************************/
+
+		CachedMath(std::unique_ptr<AbstractMath> engine,
+				   MathCache& cache = MathCache::shared());
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a new CachedMath with an engine created on
+		*		   first use.
+		*
+		*	@param factory The factory for the engine.
+		*
+		*	@param settings The settings (those of the engine).
+		*
+		*	@param fingerprint The fingerprint the engine will have.
+		*
+		*	@param cache The cache to use (by default the shared one).
+		*
+		***********************************************************************/
+
+		CachedMath(const factory_t& factory,
+				   const Configurable::settings_t& settings,
+				   const std::string& fingerprint,
+				   MathCache& cache = MathCache::shared());
+
+		/*******************************************************************//*!
+		*
+		*	@brief Renders math to HTML, if it is not cached.
+		*
+		*	@param expression A string containing a LaTeX expression.
+		*
+		*	@param display_math Whether to use display-math for the expression.
+		*
+		*	@return The HTML.
+		*
+		***********************************************************************/
+
+		virtual std::string render(const std::string& expression,
+								   bool display_math = false) override;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Renders the expressions that are not cached.
+		*
+		*	@param expressions The expressions to render.
+		*
+		*	@return The HTML for each expression, in the same order.
+		*
+		***********************************************************************/
+
+		virtual std::vector<std::string>
+		render(const std::vector<expression_t>& expressions) override;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the fingerprint of the engine.
+		*
+		***********************************************************************/
+
+		virtual std::string fingerprint() const override;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Lets the engine clean up.
+		*
+		***********************************************************************/
+
+		virtual void idle() override;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the engine (creating it if necessary).
+		*
+		***********************************************************************/
+
+		AbstractMath& engine();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the cache.
+		*
+		***********************************************************************/
+
+		MathCache& cache();
+
+	private:
+
+		/*******************************************************************//*!
+		*
+		*	@brief Collapses runs of whitespace in an expression.
+		*
+		*	@details Leading and trailing whitespace is removed, except for
+		*			 an escaped (i.e. significant) trailing space. Expressions
+		*			 that may contain comments are left as they are.
+		*
+		*	@param expression The expression.
+		*
+		*	@return The normalized expression.
+		*
+		***********************************************************************/
+
+		static std::string _normalize(const std::string& expression);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the engine, creating it if necessary.
+		*
+		***********************************************************************/
+
+		AbstractMath* _create() const;
+
+		/*! The factory for the engine (if it is created lazily). */
+		factory_t _factory;
+
+		/*! The engine to render misses with (created on first use). */
+		mutable std::unique_ptr<AbstractMath> _engine;
+
+		/*! The fingerprint of a lazily created engine. */
+		std::string _fingerprint;
+
+		/*! The cache. */
+		MathCache& _cache;
+	};
+}
+
+#endif /* MARKDOWN_CACHED_MATH_HPP */
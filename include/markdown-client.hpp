@@ -0,0 +1,94 @@
+/***************************************************************************//*!
+*
+*	@file markdown-client.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_CLIENT_HPP
+#define MARKDOWN_CLIENT_HPP
+
+#include "markdown-configurable.hpp"
+#include "markdown-connection.hpp"
+
+#include <string>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief Renders markdown through a Server.
+	*
+	*	@details The Server's Parsers use the Server's root and stylesheet;
+	*			 only their settings can be overridden per request.
+	*
+	***************************************************************************/
+
+	class Client
+	{
+	public:
+
+		/*******************************************************************//*!
+		*
+		*	@brief Connects to a Server.
+		*
+		*	@param path The path of the Server's socket.
+		*
+		*	@throws FileException If no Server is listening on the socket.
+		*
+		***********************************************************************/
+
+		Client(const std::string& path);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Renders markdown to an HTML document.
+		*
+		*	@param markdown The markdown to render.
+		*
+		*	@param overrides Settings of the Parser to use for this request.
+		*
+		*	@return The HTML document.
+		*
+		*	@throws ServerException If the Server could not render the markdown.
+		*
+		*	@throws FileException If the connection broke.
+		*
+		***********************************************************************/
+
+		std::string render(const std::string& markdown,
+						   const Configurable::settings_t& overrides = {});
+
+		/*******************************************************************//*!
+		*
+		*	@brief Retrieves the Server's latency metrics.
+		*
+		*	@return The metrics, formatted for humans.
+		*
+		***********************************************************************/
+
+		std::string statistics();
+
+	private:
+
+		/*******************************************************************//*!
+		*
+		*	@brief Sends a request and receives the response.
+		*
+		*	@param request The request.
+		*
+		*	@return The response's payload.
+		*
+		*	@throws ServerException If the response is an error.
+		*
+		***********************************************************************/
+
+		std::string _request(const Connection::message_t& request);
+
+		/*! The connection to the Server. */
+		Connection _connection;
+	};
+}
+
+#endif /* MARKDOWN_CLIENT_HPP */
@@ -0,0 +1,212 @@
+/***************************************************************************//*!
+*
+*	@file markdown-code-cache.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_CODE_CACHE_HPP
+#define MARKDOWN_CODE_CACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <v8.h>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief A process-wide, persistent cache of compiled V8 scripts.
+	*
+	*	@details The first compilation of a script produces V8 code-cache
+	*			 data, which is stored in a file next to the script (or in
+	*			 a cache directory) and kept in memory. Later compilations,
+	*			 also in later processes, consume that data instead of
+	*			 compiling the script from scratch. A cache file starts with
+	*			 a header holding the V8 version and a hash of the script,
+	*			 such that caches of another V8 or script version are never
+	*			 offered to V8. If V8 rejects the data nevertheless (e.g.
+	*			 because of different V8 flags), the script is compiled
+	*			 from source and the cache replaced. All methods are
+	*			 thread-safe.
+	*
+	***************************************************************************/
+
+	class CodeCache
+	{
+	public:
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the cache shared by all engines in the process.
+		*
+		***********************************************************************/
+
+		static CodeCache& shared();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs an empty CodeCache.
+		*
+		***********************************************************************/
+
+		CodeCache();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-constructor.
+		*
+		***********************************************************************/
+
+		CodeCache(const CodeCache& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-assignment operator.
+		*
+		***********************************************************************/
+
+		CodeCache& operator=(const CodeCache& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Compiles a script, consuming or producing cache data.
+		*
+		*	@details Must be called with the context's isolate entered and
+		*			 inside a handle-scope.
+		*
+		*	@param context The context to compile the script in.
+		*
+		*	@param path The path of the script (which names the cache).
+		*
+		*	@param source The source of the script.
+		*
+		*	@param directory The directory for the cache file (empty to store
+		*					 it next to the script).
+		*
+		*	@return The compiled script.
+		*
+		*	@throws ParseException If the script could not be compiled.
+		*
+		***********************************************************************/
+
+		v8::Local<v8::Script> compile(const v8::Local<v8::Context>& context,
+									  const std::string& path,
+									  const std::string& source,
+									  const std::string& directory = "");
+
+		/*******************************************************************//*!
+		*
+		*	@brief Removes all cache data from memory (the counters are kept).
+		*
+		***********************************************************************/
+
+		void clear();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns how often V8 accepted cache data.
+		*
+		***********************************************************************/
+
+		std::size_t accepted() const noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns how often V8 rejected cache data.
+		*
+		***********************************************************************/
+
+		std::size_t rejected() const noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns how often cache data was produced.
+		*
+		***********************************************************************/
+
+		std::size_t produced() const noexcept;
+
+	private:
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the header of cache files for a script.
+		*
+		*	@param source The source of the script.
+		*
+		***********************************************************************/
+
+		static std::string _header(const std::string& source);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the path of the cache file for a script.
+		*
+		*	@param path The path of the script.
+		*
+		*	@param directory The cache directory (empty for the script's).
+		*
+		***********************************************************************/
+
+		static std::string _file(const std::string& path,
+								 const std::string& directory);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Looks up cache data, in memory or else on disk.
+		*
+		*	@param file The path of the cache file.
+		*
+		*	@param header The expected header.
+		*
+		*	@param data The cache data to fill in.
+		*
+		*	@return True if there is (up-to-date) data, else false.
+		*
+		***********************************************************************/
+
+		bool _find(const std::string& file,
+				   const std::string& header,
+				   std::string& data);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Stores cache data in memory and on disk.
+		*
+		*	@details Failing to write the file is not an error.
+		*
+		*	@param file The path of the cache file.
+		*
+		*	@param header The header.
+		*
+		*	@param data The cache data.
+		*
+		***********************************************************************/
+
+		void _store(const std::string& file,
+					const std::string& header,
+					std::string data);
+
+		/*! Guards the entries. */
+		std::mutex _mutex;
+
+		/*! The cache data (header included), by cache file. */
+		std::unordered_map<std::string, std::string> _entries;
+
+		/*! The number of times V8 accepted cache data. */
+		std::atomic<std::size_t> _accepted;
+
+		/*! The number of times V8 rejected cache data. */
+		std::atomic<std::size_t> _rejected;
+
+		/*! The number of times cache data was produced. */
+		std::atomic<std::size_t> _produced;
+	};
+}
+
+#endif /* MARKDOWN_CODE_CACHE_HPP */
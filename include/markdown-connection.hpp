@@ -0,0 +1,165 @@
+/***************************************************************************//*!
+*
+*	@file markdown-connection.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_CONNECTION_HPP
+#define MARKDOWN_CONNECTION_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief A connection between a render Client and Server.
+	*
+	*	@details Messages are sequences of strings. On the wire, a message
+	*			 is a frame of its total size followed by every string's
+	*			 size and bytes (all sizes as 32-bit big-endian integers).
+	*			 A request's first string is its command ("render" or
+	*			 "statistics"), a response's is its status ("ok" or
+	*			 "error"). The Connection owns (and closes) its socket.
+	*
+	***************************************************************************/
+
+	class Connection
+	{
+	public:
+
+		/*! A message. */
+		using message_t = std::vector<std::string>;
+
+		/*! The maximum size of a frame. */
+		static const std::size_t maximum_size;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Connects to a Unix domain socket.
+		*
+		*	@param path The path of the socket.
+		*
+		*	@throws FileException If the connection could not be established.
+		*
+		***********************************************************************/
+
+		static Connection connect(const std::string& path);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a Connection from a connected socket.
+		*
+		*	@param descriptor The socket's file descriptor (taken over).
+		*
+		***********************************************************************/
+
+		explicit Connection(int descriptor = -1) noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Move-constructs a Connection.
+		*
+		*	@param other The other Connection (which is left closed).
+		*
+		***********************************************************************/
+
+		Connection(Connection&& other) noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Move-assigns a Connection.
+		*
+		*	@param other The other Connection (which is left closed).
+		*
+		***********************************************************************/
+
+		Connection& operator=(Connection&& other) noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-constructor.
+		*
+		***********************************************************************/
+
+		Connection(const Connection& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-assignment operator.
+		*
+		***********************************************************************/
+
+		Connection& operator=(const Connection& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Closes the socket.
+		*
+		***********************************************************************/
+
+		~Connection();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Sends a message.
+		*
+		*	@param message The message to send.
+		*
+		*	@throws FileException If the message could not be sent.
+		*
+		***********************************************************************/
+
+		void send(const message_t& message);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Receives a message.
+		*
+		*	@param message The message to fill in.
+		*
+		*	@return True if a message was received, false if the peer closed
+		*			the connection (between messages).
+		*
+		*	@throws FileException If the message is malformed or truncated.
+		*
+		***********************************************************************/
+
+		bool receive(message_t& message);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the socket's file descriptor.
+		*
+		***********************************************************************/
+
+		int descriptor() const noexcept;
+
+	private:
+
+		/*******************************************************************//*!
+		*
+		*	@brief Reads exactly a number of bytes.
+		*
+		*	@param buffer Where to store the bytes.
+		*
+		*	@param size The number of bytes to read.
+		*
+		*	@return False if the connection was closed before the first byte.
+		*
+		*	@throws FileException If the connection broke after the first byte.
+		*
+		***********************************************************************/
+
+		bool _read(char* buffer, std::size_t size);
+
+		/*! The socket's file descriptor. */
+		int _descriptor;
+	};
+}
+
+#endif /* MARKDOWN_CONNECTION_HPP */
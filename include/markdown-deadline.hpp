@@ -0,0 +1,145 @@
+/***************************************************************************//*!
+*
+*	@file markdown-deadline.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_DEADLINE_HPP
+#define MARKDOWN_DEADLINE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief A point in time by which a render must finish, which can
+	*		   also be cancelled early.
+	*
+	*	@details Copies share their state, so a copy handed to a renderer
+	*			 expires when the original is cancelled, from any thread.
+	*			 A default-constructed Deadline never expires (unless it
+	*			 is cancelled), and is not watched by the Watchdog, so
+	*			 it costs renders nothing. Cancelling it takes effect
+	*			 before the next stage or equation. Use cancellable()
+	*			 for a Deadline whose cancellation also interrupts the
+	*			 math engines.
+	*
+	***************************************************************************/
+
+	class Deadline
+	{
+	public:
+
+		using clock_t = std::chrono::steady_clock;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a Deadline that never expires by itself.
+		*
+		***********************************************************************/
+
+		Deadline();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a Deadline some time from now.
+		*
+		*	@param timeout The time from now until the Deadline expires.
+		*
+		***********************************************************************/
+
+		explicit Deadline(clock_t::duration timeout);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns a Deadline without a time whose cancellation
+		*		   interrupts the math engines (see watched()).
+		*
+		***********************************************************************/
+
+		static Deadline cancellable();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Expires the Deadline (and all its copies) now.
+		*
+		***********************************************************************/
+
+		void cancel() noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns whether the Deadline passed or was cancelled.
+		*
+		***********************************************************************/
+
+		bool expired() const noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns whether the Deadline has a time (or may only
+		*		   be cancelled).
+		*
+		***********************************************************************/
+
+		bool limited() const noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the time the Deadline expires at (if limited).
+		*
+		***********************************************************************/
+
+		clock_t::time_point time() const noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns whether math engines have the Watchdog watch the
+		*		   Deadline (if it is limited or cancellable()).
+		*
+		***********************************************************************/
+
+		bool watched() const noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Throws if the Deadline expired.
+		*
+		*	@param stage What was about to be done (for the message).
+		*
+		*	@throws TimeoutException If the Deadline expired.
+		*
+		***********************************************************************/
+
+		void check(const std::string& stage) const;
+
+	private:
+
+		/*! The state shared by copies. */
+		struct State
+		{
+			/*! The time the Deadline expires at (if limited). */
+			clock_t::time_point time;
+
+			/*! Whether the Deadline has a time. */
+			bool limited;
+
+			/*! Whether the Deadline is watched without a time. */
+			bool cancellable;
+
+			/*! Whether cancel() was called. */
+			std::atomic<bool> cancelled;
+		};
+
+		/*! The state. */
+		std::shared_ptr<State> _state;
+	};
+}
+
+#endif /* MARKDOWN_DEADLINE_HPP */
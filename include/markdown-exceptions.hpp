@@ -39,6 +39,22 @@ namespace Markdown
 		: std::runtime_error(what)
 		{ }
 	};
+	
+	/*! Thrown when a Deadline expired before rendering finished. */
+	struct TimeoutException : public std::runtime_error
+	{
+		TimeoutException(const std::string& what)
+		: std::runtime_error(what)
+		{ }
+	};
+	
+	/*! Thrown when a render server could not handle a request. */
+	struct ServerException : public std::runtime_error
+	{
+		ServerException(const std::string& what)
+		: std::runtime_error(what)
+		{ }
+	};
 }
 
 #endif /* MARKDOWN_EXCEPTIONS_HPP */
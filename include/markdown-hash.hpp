@@ -0,0 +1,91 @@
+/***************************************************************************//*!
+*
+*	@file markdown-hash.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_HASH_HPP
+#define MARKDOWN_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief An incremental, non-cryptographic 64-bit hash (FNV-1a).
+	*
+	*	@details Used to detect changed contents (inputs, settings, scripts),
+	*			 not to protect against deliberate collisions.
+	*
+	***************************************************************************/
+
+	class Hash
+	{
+	public:
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a Hash of nothing.
+		*
+		***********************************************************************/
+
+		Hash() noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Adds data to the hash.
+		*
+		*	@param data A pointer to the data.
+		*
+		*	@param size The size of the data.
+		*
+		*	@return The Hash itself.
+		*
+		***********************************************************************/
+
+		Hash& update(const char* data, std::size_t size) noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Adds a string to the hash.
+		*
+		*	@details The size is hashed too, such that consecutive strings
+		*			 cannot run into each other (e.g. "ab" + "c" != "a" + "bc").
+		*
+		*	@param string The string to add.
+		*
+		*	@return The Hash itself.
+		*
+		***********************************************************************/
+
+		Hash& update(const std::string& string);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the hash of all data added so far.
+		*
+		***********************************************************************/
+
+		std::uint64_t digest() const noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the digest as 16 hexadecimal digits.
+		*
+		***********************************************************************/
+
+		std::string hex() const;
+
+	private:
+
+		/*! The current state. */
+		std::uint64_t _state;
+	};
+}
+
+#endif /* MARKDOWN_HASH_HPP */
@@ -0,0 +1,155 @@
+/***************************************************************************//*!
+*
+*	@file markdown-highlight-cache.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_HIGHLIGHT_CACHE_HPP
+#define MARKDOWN_HIGHLIGHT_CACHE_HPP
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief An in-memory store of highlighted code.
+	*
+	*	@details Maps keys (hashes of the language, the code and the
+	*			 highlight.js version, see Highlighter) to HTML, up to a
+	*			 capacity in bytes, evicting the least recently used
+	*			 entries. All methods are thread-safe.
+	*
+	***************************************************************************/
+
+	class HighlightCache
+	{
+	public:
+
+		/*! The default capacity. */
+		static const std::size_t default_capacity;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs an empty HighlightCache.
+		*
+		*	@param capacity The maximum number of bytes kept.
+		*
+		***********************************************************************/
+
+		HighlightCache(std::size_t capacity = default_capacity);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-constructor.
+		*
+		***********************************************************************/
+
+		HighlightCache(const HighlightCache& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-assignment operator.
+		*
+		***********************************************************************/
+
+		HighlightCache& operator=(const HighlightCache& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Looks up the HTML for a key.
+		*
+		*	@param key The key.
+		*
+		*	@param html The HTML to fill in.
+		*
+		*	@return True on a hit, else false.
+		*
+		***********************************************************************/
+
+		bool find(const std::string& key, std::string& html);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Stores the HTML for a key.
+		*
+		*	@param key The key.
+		*
+		*	@param html The HTML.
+		*
+		***********************************************************************/
+
+		void insert(const std::string& key, const std::string& html);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Sets the maximum number of bytes kept.
+		*
+		*	@param capacity The capacity (evicting entries beyond it).
+		*
+		***********************************************************************/
+
+		void capacity(std::size_t capacity);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the maximum number of bytes kept.
+		*
+		***********************************************************************/
+
+		std::size_t capacity() const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the number of entries.
+		*
+		***********************************************************************/
+
+		std::size_t size() const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Removes all entries.
+		*
+		***********************************************************************/
+
+		void clear();
+
+	private:
+
+		/*! The entries, most recently used first. */
+		using entries_t = std::list<std::pair<std::string, std::string>>;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Evicts entries until the capacity is respected.
+		*
+		***********************************************************************/
+
+		void _evict();
+
+		/*! Guards everything. */
+		mutable std::mutex _mutex;
+
+		/*! The entries, most recently used first. */
+		entries_t _entries;
+
+		/*! The entries by key. */
+		std::unordered_map<std::string, entries_t::iterator> _index;
+
+		/*! The maximum number of bytes. */
+		std::size_t _capacity;
+
+		/*! The number of bytes of the keys and HTML. */
+		std::size_t _bytes;
+	};
+}
+
+#endif /* MARKDOWN_HIGHLIGHT_CACHE_HPP */
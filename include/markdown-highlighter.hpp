@@ -0,0 +1,146 @@
+/***************************************************************************//*!
+*
+*	@file markdown-highlighter.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_HIGHLIGHTER_HPP
+#define MARKDOWN_HIGHLIGHTER_HPP
+
+#include "markdown-highlight-cache.hpp"
+
+#include <string>
+#include <v8.h>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief Highlights code with highlight.js at render time.
+	*
+	*	@details Runs highlight.js (script.js in the highlight folder) in an
+	*			 isolate of its own, producing the same markup that
+	*			 hljs.initHighlightingOnLoad() would in the browser, such
+	*			 that documents only need the theme's stylesheet. Code
+	*			 blocks without a known language are auto-detected. Results
+	*			 are kept in a process-wide HighlightCache keyed by the
+	*			 language, the code and the highlight.js version. A
+	*			 Highlighter must be used by one thread at a time.
+	*
+	***************************************************************************/
+
+	class Highlighter
+	{
+	public:
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the store of highlighted code shared by all
+		*		   Highlighters.
+		*
+		***********************************************************************/
+
+		static HighlightCache& cache();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns a hash of the highlight.js library in a folder.
+		*
+		*	@param highlight_path The path to the highlight folder.
+		*
+		*	@throws FileException If script.js could not be read.
+		*
+		***********************************************************************/
+
+		static std::string fingerprint(const std::string& highlight_path);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a new Highlighter.
+		*
+		*	@param highlight_path The path to the highlight folder.
+		*
+		*	@throws FileException If script.js could not be loaded.
+		*
+		***********************************************************************/
+
+		Highlighter(const std::string& highlight_path);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-constructor.
+		*
+		***********************************************************************/
+
+		Highlighter(const Highlighter& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-assignment operator.
+		*
+		***********************************************************************/
+
+		Highlighter& operator=(const Highlighter& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Disposes of the isolate.
+		*
+		***********************************************************************/
+
+		~Highlighter();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Highlights a code block.
+		*
+		*	@param code The code (not HTML-escaped).
+		*
+		*	@param language The language (empty to auto-detect).
+		*
+		*	@return The <pre><code> block.
+		*
+		*	@throws ParseException If highlight.js failed.
+		*
+		***********************************************************************/
+
+		std::string highlight(const std::string& code,
+							  const std::string& language);
+
+	private:
+
+		/*! The source of the JavaScript helper calling highlight.js. */
+		static const std::string _helper_source;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Executes a compiled script.
+		*
+		*	@param script The script.
+		*
+		*	@param context The context to run it in.
+		*
+		*	@throws ParseException If the script threw.
+		*
+		***********************************************************************/
+
+		v8::Local<v8::Value> _execute(const v8::Local<v8::Script>& script,
+									  const v8::Local<v8::Context>& context);
+
+		/*! The isolate. */
+		v8::Isolate* _isolate;
+
+		/*! The context with highlight.js loaded. */
+		v8::UniquePersistent<v8::Context> _persistent_context;
+
+		/*! The JavaScript helper calling highlight.js. */
+		v8::UniquePersistent<v8::Function> _persistent_helper;
+
+		/*! The hash of script.js. */
+		std::string _fingerprint;
+	};
+}
+
+#endif /* MARKDOWN_HIGHLIGHTER_HPP */
@@ -0,0 +1,196 @@
+/***************************************************************************//*!
+*
+*	@file markdown-macros.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_MACROS_HPP
+#define MARKDOWN_MACROS_HPP
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief A table of LaTeX macros, expanded in equations before they
+	*		   are rendered.
+	*
+	*	@details Macros are defined by a preamble of LaTeX definitions:
+	*
+	*			 \newcommand{\R}{\mathbb{R}}
+	*			 \newcommand{\norm}[1]{\left\lVert #1 \right\rVert}
+	*			 \def\pair#1#2{(#1, #2)}
+	*
+	*			 (\renewcommand redefines a macro, \providecommand defines
+	*			 it only if it is not yet defined, and % starts a comment).
+	*			 The preamble is parsed once, after which expand() replaces
+	*			 the macros in equations, such that every math engine sees
+	*			 (and caches) plain LaTeX. An argument is a {group} or a
+	*			 single token. Expansion is recursive, up to max_depth.
+	*
+	***************************************************************************/
+
+	class Macros
+	{
+	public:
+
+		/*! How deeply macros may expand into other macros. */
+		static const std::size_t max_depth;
+
+		/*! The largest expansion of a single equation (in bytes). */
+		static const std::size_t max_size;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs an empty Macros table.
+		*
+		***********************************************************************/
+
+		Macros() = default;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a Macros table from a preamble.
+		*
+		*	@param preamble The LaTeX definitions.
+		*
+		*	@throws ParseException If a definition is malformed.
+		*
+		***********************************************************************/
+
+		explicit Macros(const std::string& preamble);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Adds the definitions of a preamble to the table.
+		*
+		*	@details Definitions replace earlier ones of the same macro.
+		*
+		*	@param preamble The LaTeX definitions.
+		*
+		*	@throws ParseException If a definition is malformed (in which
+		*			case the table is left unchanged).
+		*
+		***********************************************************************/
+
+		void define(const std::string& preamble);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Expands the macros in an equation.
+		*
+		*	@param expression The LaTeX expression.
+		*
+		*	@return The expression without any of the macros.
+		*
+		*	@throws ParseException If a macro is missing an argument or the
+		*			expansion exceeds max_depth or max_size.
+		*
+		***********************************************************************/
+
+		std::string expand(const std::string& expression) const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns whether no macros are defined.
+		*
+		***********************************************************************/
+
+		bool empty() const noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the number of macros defined.
+		*
+		***********************************************************************/
+
+		std::size_t size() const noexcept;
+
+	private:
+
+		/*! A macro's definition. */
+		struct Macro
+		{
+			/*! The number of arguments (#1 to #9). */
+			std::size_t arguments;
+
+			/*! The replacement text. */
+			std::string body;
+		};
+
+		using table_t = std::unordered_map<std::string, Macro>;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Expands the macros in a text, recursively.
+		*
+		*	@param text The text.
+		*
+		*	@param depth The number of enclosing expansions.
+		*
+		*	@param result The string to append the expansion to.
+		*
+		***********************************************************************/
+
+		void _expand(const std::string& text,
+					 std::size_t depth,
+					 std::string& result) const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Substitutes the arguments of a macro into its body.
+		*
+		***********************************************************************/
+
+		static std::string _substitute(const std::string& body,
+									   const std::vector<std::string>& arguments);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Reads a control sequence (e.g. \alpha or \{).
+		*
+		*	@param text The text.
+		*
+		*	@param position The position of the backslash, advanced past
+		*			the control sequence.
+		*
+		*	@return The control sequence.
+		*
+		***********************************************************************/
+
+		static std::string _control_sequence(const std::string& text,
+											 std::size_t& position);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Reads a {group} (without its braces) or a single token.
+		*
+		*	@param text The text.
+		*
+		*	@param position The position to read from, advanced past the
+		*			argument (and any spaces before it).
+		*
+		*	@param what What is read (for error messages).
+		*
+		*	@return The argument.
+		*
+		*	@throws ParseException If there is none or the group is not closed.
+		*
+		***********************************************************************/
+
+		static std::string _argument(const std::string& text,
+									 std::size_t& position,
+									 const std::string& what);
+
+		/*! The macros by name (including the backslash). */
+		table_t _table;
+	};
+}
+
+#endif /* MARKDOWN_MACROS_HPP */
@@ -0,0 +1,134 @@
+/***************************************************************************//*!
+*
+*	@file markdown-manifest.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_MANIFEST_HPP
+#define MARKDOWN_MANIFEST_HPP
+
+#include <string>
+#include <unordered_map>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief An on-disk record of what each output was rendered from.
+	*
+	*	@details For every output, the manifest stores the input path, a
+	*			 hash of the input's contents and a hash of the effective
+	*			 settings (see Parser::fingerprint()), such that outputs
+	*			 whose hashes still match need not be rendered again.
+	*			 The file holds one tab-separated entry per line, with
+	*			 tabs, newlines and backslashes in paths escaped as \t,
+	*			 \n and \\.
+	*
+	***************************************************************************/
+
+	class Manifest
+	{
+	public:
+
+		/*! What an output was rendered from. */
+		struct Entry
+		{
+			/*! The path of the markdown file. */
+			std::string input;
+
+			/*! The hash of the markdown file's contents. */
+			std::string input_hash;
+
+			/*! The hash of the Parser's effective settings. */
+			std::string settings_hash;
+		};
+
+		/*! The entries, by output path. */
+		using entries_t = std::unordered_map<std::string, Entry>;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a Manifest, loading the file if it exists.
+		*
+		*	@param path The path of the manifest file.
+		*
+		***********************************************************************/
+
+		Manifest(const std::string& path);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Looks up the entry for an output.
+		*
+		*	@param output The path of the output.
+		*
+		*	@return A pointer to the entry, or a null pointer if there is none.
+		*
+		***********************************************************************/
+
+		const Entry* find(const std::string& output) const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Sets the entry for an output.
+		*
+		*	@param output The path of the output.
+		*
+		*	@param entry The new entry.
+		*
+		***********************************************************************/
+
+		void update(const std::string& output, const Entry& entry);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Removes the entry for an output.
+		*
+		*	@param output The path of the output.
+		*
+		***********************************************************************/
+
+		void erase(const std::string& output);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns all entries.
+		*
+		***********************************************************************/
+
+		const entries_t& entries() const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Writes the manifest to its file.
+		*
+		*	@details Writes a temporary file first and renames it, such that
+		*			 an interrupted write never leaves a corrupt manifest.
+		*
+		*	@throws FileException If the file could not be written.
+		*
+		***********************************************************************/
+
+		void save() const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the path of the manifest file.
+		*
+		***********************************************************************/
+
+		const std::string& path() const;
+
+	private:
+
+		/*! The path of the manifest file. */
+		std::string _path;
+
+		/*! The entries, by output path. */
+		entries_t _entries;
+	};
+}
+
+#endif /* MARKDOWN_MANIFEST_HPP */
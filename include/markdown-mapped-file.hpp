@@ -0,0 +1,137 @@
+/***************************************************************************//*!
+*
+*	@file markdown-mapped-file.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_MAPPED_FILE_HPP
+#define MARKDOWN_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <streambuf>
+#include <string>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief A read-only view of a file's contents.
+	*
+	*	@details Large files are memory-mapped, small files are read with
+	*			 a single read() of their size into a buffer. The contents
+	*			 can be accessed directly via data() and size(), or read
+	*			 through an std::istream, as the MappedFile is also the
+	*			 (copy-free) stream-buffer for its contents.
+	*
+	***************************************************************************/
+
+	class MappedFile : public std::streambuf
+	{
+	public:
+
+		/*! The size from which files are memory-mapped. */
+		static const std::size_t mapping_threshold;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Opens and maps (or reads) a file.
+		*
+		*	@param path The path to the file.
+		*
+		*	@throws FileException If the file could not be opened or read.
+		*
+		***********************************************************************/
+
+		MappedFile(const std::string& path);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-constructor.
+		*
+		***********************************************************************/
+
+		MappedFile(const MappedFile& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-assignment operator.
+		*
+		***********************************************************************/
+
+		MappedFile& operator=(const MappedFile& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Unmaps the file.
+		*
+		***********************************************************************/
+
+		~MappedFile();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns a pointer to the file's contents.
+		*
+		*	@details The contents are __not__ null-terminated.
+		*
+		***********************************************************************/
+
+		const char* data() const noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the size of the file's contents.
+		*
+		***********************************************************************/
+
+		std::size_t size() const noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the size of the contents without trailing whitespace.
+		*
+		***********************************************************************/
+
+		std::size_t trimmed_size() const noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns whether the file is memory-mapped.
+		*
+		***********************************************************************/
+
+		bool mapped() const noexcept;
+
+	private:
+
+		/*******************************************************************//*!
+		*
+		*	@brief Reads the rest of a file into the buffer.
+		*
+		*	@param descriptor The file descriptor.
+		*
+		*	@param size The expected size (0 if unknown).
+		*
+		*	@return True if the file could be read, else false.
+		*
+		***********************************************************************/
+
+		bool _read(int descriptor, std::size_t size);
+
+		/*! The contents of the file. */
+		const char* _data;
+
+		/*! The size of the contents. */
+		std::size_t _size;
+
+		/*! Whether _data points to a mapping. */
+		bool _mapped;
+
+		/*! The contents of small files. */
+		std::string _buffer;
+	};
+}
+
+#endif /* MARKDOWN_MAPPED_FILE_HPP */
@@ -11,8 +11,7 @@
 
 #include "markdown-abstract-markdown.hpp"
 
-#include <cstdint>
-#include <memory>
+#include <cstddef>
 #include <string>
 
 struct hoedown_buffer;
@@ -151,6 +150,23 @@ namespace Markdown
 		
 		std::string render(const std::string& markdown) override;
 		
+		/*******************************************************************//*!
+		*
+ 		*	@brief Renders Markdown to HTML.
+		*
+		*	@details Hands the markdown to hoedown directly, without copying.
+		*
+		*	@param markdown A pointer to the markdown (not null-terminated).
+		*
+		*	@param size The size of the markdown.
+		*
+		*	@return A one-to-one translation of the markdown to HTML
+		*			(i.e. no <body>, <html> or other enclosing tags.)
+		*
+		***********************************************************************/
+		
+		std::string render(const char* markdown, std::size_t size) override;
+		
 		/*******************************************************************//*!
 		*
  		*	@brief Sets configuration-settings from flags.
@@ -187,20 +203,6 @@ namespace Markdown
 		inline hoedown_buffer*
 		_verify_buffer_size(std::size_t new_size) const;
 		
-		/*******************************************************************//*!
-		*
- 		*	@brief Converts a string to a const std::uint8_t* safely.
-		*
-		*	@param string A std::string.
-		*
-		*	@return A `std::unique_ptr<std::uint8_t[]>` from which the pointer
-		*			can safely be retrieved via `std::unique_ptr<T>::get()`.
-		*
-		***********************************************************************/
-		
-		inline std::unique_ptr<std::uint8_t[]>
-		_to_uint8_string(const std::string& string) const;
-		
 		/*******************************************************************//*!
 		*
  		*	@brief Converts a hoedown_buffer to a string.
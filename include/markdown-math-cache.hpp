@@ -0,0 +1,247 @@
+/***************************************************************************//*!
+*
+*	@file markdown-math-cache.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_MATH_CACHE_HPP
+#define MARKDOWN_MATH_CACHE_HPP
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief A content-addressed store of rendered equations.
+	*
+	*	@details Maps keys (hashes of everything that determines an
+	*			 equation's HTML, see CachedMath) to HTML. Entries are kept
+	*			 in memory up to a capacity in bytes, evicting the least
+	*			 recently used ones. If a directory is set, entries are
+	*			 also written to (and, on a miss in memory, read from) one
+	*			 file per key in that directory, such that they survive
+	*			 across runs and are shared between processes. All methods
+	*			 are thread-safe.
+	*
+	***************************************************************************/
+
+	class MathCache
+	{
+	public:
+
+		/*! Counters of a MathCache. */
+		struct Statistics
+		{
+			/*! The number of lookups served from memory. */
+			std::size_t hits;
+
+			/*! The number of lookups served from the directory. */
+			std::size_t disk_hits;
+
+			/*! The number of lookups that found nothing. */
+			std::size_t misses;
+
+			/*! The number of entries evicted from memory. */
+			std::size_t evictions;
+
+			/*! The number of entries in memory. */
+			std::size_t entries;
+
+			/*! The number of bytes of the entries in memory. */
+			std::size_t bytes;
+
+			/*! The fraction of lookups that were hits (in memory or on disk). */
+			double hit_rate() const noexcept;
+
+			/*! Formats the statistics for humans. */
+			std::string to_string() const;
+		};
+
+		/*! The default capacity of the in-memory store. */
+		static const std::size_t default_capacity;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the cache shared by all engines in the process.
+		*
+		***********************************************************************/
+
+		static MathCache& shared();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs an empty MathCache.
+		*
+		*	@param capacity The maximum number of bytes kept in memory.
+		*
+		*	@param directory The directory of the persistent store (empty
+		*					 for none).
+		*
+		***********************************************************************/
+
+		MathCache(std::size_t capacity = default_capacity,
+				  const std::string& directory = "");
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-constructor.
+		*
+		***********************************************************************/
+
+		MathCache(const MathCache& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-assignment operator.
+		*
+		***********************************************************************/
+
+		MathCache& operator=(const MathCache& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Looks up the HTML for a key.
+		*
+		*	@param key The key.
+		*
+		*	@param html The HTML to fill in.
+		*
+		*	@return True on a hit, else false.
+		*
+		***********************************************************************/
+
+		bool find(const std::string& key, std::string& html);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Stores the HTML for a key.
+		*
+		*	@details Failing to write to the directory is not an error.
+		*
+		*	@param key The key.
+		*
+		*	@param html The HTML.
+		*
+		***********************************************************************/
+
+		void insert(const std::string& key, const std::string& html);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Sets the maximum number of bytes kept in memory.
+		*
+		*	@param capacity The capacity (evicting entries beyond it).
+		*
+		***********************************************************************/
+
+		void capacity(std::size_t capacity);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the maximum number of bytes kept in memory.
+		*
+		***********************************************************************/
+
+		std::size_t capacity() const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Sets the directory of the persistent store.
+		*
+		*	@param directory The directory (created on demand), or empty.
+		*
+		***********************************************************************/
+
+		void directory(const std::string& directory);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the directory of the persistent store.
+		*
+		***********************************************************************/
+
+		std::string directory() const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Removes all entries from memory (the counters are kept).
+		*
+		***********************************************************************/
+
+		void clear();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the counters.
+		*
+		***********************************************************************/
+
+		Statistics statistics() const;
+
+	private:
+
+		/*! The entries, most recently used first. */
+		using entries_t = std::list<std::pair<std::string, std::string>>;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Stores an entry in memory (with the mutex locked).
+		*
+		*	@param key The key.
+		*
+		*	@param html The HTML.
+		*
+		***********************************************************************/
+
+		void _remember(const std::string& key, const std::string& html);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Evicts entries until the capacity is respected.
+		*
+		***********************************************************************/
+
+		void _evict();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the path of a key's file in a directory.
+		*
+		*	@param directory The directory of the persistent store.
+		*
+		*	@param key The key.
+		*
+		***********************************************************************/
+
+		static std::string _file(const std::string& directory,
+								 const std::string& key);
+
+		/*! Guards everything. */
+		mutable std::mutex _mutex;
+
+		/*! The entries, most recently used first. */
+		entries_t _entries;
+
+		/*! The entries by key. */
+		std::unordered_map<std::string, entries_t::iterator> _index;
+
+		/*! The maximum number of bytes in memory. */
+		std::size_t _capacity;
+
+		/*! The directory of the persistent store (empty for none). */
+		std::string _directory;
+
+		/*! The counters (entries and bytes are kept up to date). */
+		Statistics _statistics;
+	};
+}
+
+#endif /* MARKDOWN_MATH_CACHE_HPP */
@@ -0,0 +1,224 @@
+/***************************************************************************//*!
+*
+*	@file markdown-math-pool.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_MATH_POOL_HPP
+#define MARKDOWN_MATH_POOL_HPP
+
+#include "markdown-abstract-math.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief Renders math on several engines in parallel.
+	*
+	*	@details The pool owns a number of worker threads, each with its own
+	*			 math engine (for Math: its own isolate and KaTeX context),
+	*			 created on that thread. The expressions of a batch are
+	*			 handed out longest first, such that a single long equation
+	*			 does not hold up the end of a batch, and the results are
+	*			 returned in order. The pool's settings are passed on to the
+	*			 engines before every batch. The Parser renders all of a
+	*			 document's equations as one batch, so a MathPool can be
+	*			 used in place of a single Math engine. Each worker lets
+	*			 its engine idle() after a batch.
+	*
+	***************************************************************************/
+
+	class MathPool : public AbstractMath
+	{
+	public:
+
+		/*! Creates a math engine for a worker. */
+		using factory_t = std::function<std::unique_ptr<AbstractMath>()>;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a pool of Math engines.
+		*
+		*	@param katex_path The path to the katex folder.
+		*
+		*	@param size The number of engines (0 = the number of cores).
+		*
+		*	@throws FileException If KaTeX could not be loaded.
+		*
+		***********************************************************************/
+
+		MathPool(const std::string& katex_path = ".", std::size_t size = 0);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a pool of engines from a factory.
+		*
+		*	@param factory The factory for the engines. Called on the
+		*				   worker threads.
+		*
+		*	@param size The number of engines (0 = the number of cores).
+		*
+		*	@param settings The settings for the engines.
+		*
+		*	@throws Whatever the factory throws.
+		*
+		***********************************************************************/
+
+		MathPool(const factory_t& factory,
+				 std::size_t size,
+				 const Configurable::settings_t& settings);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-constructor.
+		*
+		***********************************************************************/
+
+		MathPool(const MathPool& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-assignment operator.
+		*
+		***********************************************************************/
+
+		MathPool& operator=(const MathPool& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Stops the workers.
+		*
+		***********************************************************************/
+
+		~MathPool();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Renders math to HTML on one of the engines.
+		*
+		*	@param expression A string containing a LaTeX expression.
+		*
+		*	@param display_math Whether to use display-math for the expression.
+		*
+		*	@return The HTML.
+		*
+		***********************************************************************/
+
+		virtual std::string render(const std::string& expression,
+								   bool display_math = false) override;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Renders many expressions in parallel.
+		*
+		*	@param expressions The expressions to render.
+		*
+		*	@return The HTML for each expression, in the same order.
+		*
+		*	@throws The first exception an engine threw (after the other
+		*			workers finished their current expression).
+		*
+		***********************************************************************/
+
+		virtual std::vector<std::string>
+		render(const std::vector<expression_t>& expressions) override;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the number of engines.
+		*
+		***********************************************************************/
+
+		std::size_t size() const noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the fingerprint of the engines.
+		*
+		***********************************************************************/
+
+		virtual std::string fingerprint() const override;
+
+	private:
+
+		/*******************************************************************//*!
+		*
+		*	@brief The main loop of a worker thread.
+		*
+		*	@param factory The factory for the worker's engine.
+		*
+		***********************************************************************/
+
+		void _work(const factory_t& factory);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Renders expressions of the current batch until none are left.
+		*
+		*	@param engine The worker's engine.
+		*
+		***********************************************************************/
+
+		void _drain(AbstractMath& engine);
+
+		/*! The worker threads. */
+		std::vector<std::thread> _threads;
+
+		/*! Lets only one batch run at a time. */
+		std::mutex _render_mutex;
+
+		/*! Guards the batch state. */
+		std::mutex _mutex;
+
+		/*! Signalled when a batch starts or the pool stops. */
+		std::condition_variable _started;
+
+		/*! Signalled when a worker is ready or finishes a batch. */
+		std::condition_variable _finished;
+
+		/*! The number of the current batch (0 before the first). */
+		std::size_t _batch;
+
+		/*! The number of workers still busy with the current batch. */
+		std::size_t _busy;
+
+		/*! The number of workers whose engine was created (or failed). */
+		std::size_t _ready;
+
+		/*! Whether the workers should exit. */
+		bool _stopping;
+
+		/*! The first exception of the current batch (or of the setup). */
+		std::exception_ptr _failure;
+
+		/*! The expressions of the current batch. */
+		const std::vector<expression_t>* _expressions;
+
+		/*! The order of the current batch's expressions (longest first). */
+		std::vector<std::size_t> _order;
+
+		/*! The position of the next expression in _order. */
+		std::atomic<std::size_t> _next;
+
+		/*! The results of the current batch. */
+		std::vector<std::string> _results;
+
+		/*! The fingerprint of the engines. */
+		std::string _fingerprint;
+	};
+}
+
+#endif /* MARKDOWN_MATH_POOL_HPP */
@@ -10,11 +10,14 @@
 #define MARKDOWN_MATH_HPP
 
 #include "markdown-abstract-math.hpp"
+#include "markdown-snapshot.hpp"
 
+#include <cstddef>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <v8.h>
+#include <vector>
 
 namespace Markdown
 {
@@ -27,6 +30,31 @@ namespace Markdown
 	*			 + all-display-math	: (true | false) [false]
 	*			 + throw			: (true | false) [true]
 	*			 + error-color		: (#hex-color) 	 [#CC0000]
+	*			 + snapshot			: (true | false) [true]
+	*			 + code-cache		: (true | false) [true]
+	*			 + code-cache-directory : (path, empty = katex folder) []
+	*			 + heap-limit		: (MiB, 0 = V8's default) [0]
+	*			 + recycle-renders	: (count, 0 = never) [0]
+	*			 + recycle-heap		: (MiB, 0 = never) [256]
+	*			 + idle-time		: (ms) [10]
+	*
+	*			 With snapshot enabled, isolates are created from the V8
+	*			 startup snapshot in the katex folder (see Snapshot), if
+	*			 there is an up-to-date one, instead of running KaTeX.
+	*			 Otherwise, with code-cache enabled, KaTeX is compiled
+	*			 through the process-wide CodeCache.
+	*
+	*			 The isolate is disposed of and created anew (recycled)
+	*			 before a render once it has rendered recycle-renders
+	*			 expressions or its used heap exceeds recycle-heap, such
+	*			 that long-running renderers do not grow. The heap is
+	*			 measured only every _heap_check_interval renders, as
+	*			 that costs about as much as rendering an expression.
+	*			 heap-limit bounds the old generation of the isolate's heap.
+	*
+	*			 Once the deadline expires, the Watchdog terminates the
+	*			 JavaScript running on the isolate, and the expressions
+	*			 are rendered as errors.
 	*
 	***************************************************************************/
 
@@ -37,6 +65,28 @@ namespace Markdown
 		/*! The default settings for this math engine. */
 		static const Configurable::settings_t default_settings;
 		
+		/*! The state of an engine's V8 heap. */
+		struct HeapStatistics
+		{
+			/*! The bytes reserved for the heap. */
+			std::size_t total;
+			
+			/*! The bytes in use by live (or not yet collected) objects. */
+			std::size_t used;
+			
+			/*! The bytes of the heap that are resident in memory. */
+			std::size_t physical;
+			
+			/*! The maximum size of the heap in bytes. */
+			std::size_t limit;
+			
+			/*! The expressions rendered since the isolate was created. */
+			std::size_t renders;
+			
+			/*! The number of times the isolate was recycled. */
+			std::size_t recycles;
+		};
+		
 		/*******************************************************************//*!
 		*
  		*	@brief Constructs a new Math engine.
@@ -64,6 +114,9 @@ namespace Markdown
 		*
  		*	@brief Move-constructs a Math engine.
 		*
+		*	@details Takes over the other engine's isolate, which is left
+		*			 without one (i.e. may only be assigned or destroyed).
+		*
 		*	@param other The other Math object.
 		*
 		***********************************************************************/
@@ -125,6 +178,27 @@ namespace Markdown
 		virtual std::string render(const std::string& expression,
 								   bool display_math = false) override;
 		
+		/*******************************************************************//*!
+		*
+		*	@brief Renders many LaTeX expressions with a single call into V8.
+		*
+		*	@details All expressions are passed to a JavaScript helper as one
+		*			 array, which renders them and reports failures per
+		*			 expression, such that one bad equation does not cost
+		*			 the others their rendering.
+		*
+		*	@param expressions The expressions to render.
+		*
+		*	@return The HTML for each expression, in the same order.
+		*
+		*	@throws ParseException For the first expression KaTeX could
+		*						   not parse, if throw-on-error is set.
+		*
+		***********************************************************************/
+		
+		virtual std::vector<std::string>
+		render(const std::vector<expression_t>& expressions) override;
+		
 		/*******************************************************************//*!
 		*
 		*	@brief Returns the currently-set KaTeX path.
@@ -143,33 +217,50 @@ namespace Markdown
 		
 		virtual void katex_path(const std::string& path);
 		
+		/*******************************************************************//*!
+		*
+		*	@brief Returns a hash of the KaTeX library the engine runs.
+		*
+		***********************************************************************/
+		
+		virtual std::string fingerprint() const override;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the state of the engine's V8 heap.
+		*
+		***********************************************************************/
+		
+		HeapStatistics heap_statistics() const;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Lets V8 collect garbage between documents.
+		*
+		*	@details Recycles the isolate if it is due. Otherwise, gives the
+		*			 garbage collector idle-time milliseconds or, if more
+		*			 than half of the heap limit is used, signals low memory
+		*			 (a full collection).
+		*
+		***********************************************************************/
+		
+		virtual void idle() override;
+		
 	private:
 		
-		struct Allocator : public v8::ArrayBuffer::Allocator
-		{
-			virtual void* Allocate(size_t length) override;
-			
-			virtual void* AllocateUninitialized(size_t length) override;
-			
-			virtual void Free(void* data, size_t) override;
-		};
+		/*! The source of the JavaScript helper rendering a batch. */
+		static const std::string _batch_source;
 		
-		static struct V8
-		{
-			V8();
-			
-			~V8();
-			
-			std::unique_ptr<v8::Platform> platform;
-			
-		} _v8;
+		/*! The renders between measurements of the heap (for recycle-heap). */
+		static const std::size_t _heap_check_interval;
 
 		/*******************************************************************//*!
 		*
 		*	@brief Creates and initializes a new v8::Isolate.
 		*
-		*	@details Deals with setting the Allocator instance in the
-		*			 isolate's parameters.
+		*	@details Deals with setting the shared allocator (see V8), the
+		*			 heap limit and the snapshot (if any) in the isolate's
+		*			 parameters. Initializes V8 on first use.
 		*
 		*	@return A __naked pointer__ to a v8::Isolate.
 		*
@@ -177,6 +268,31 @@ namespace Markdown
 
 		v8::Isolate* _new_isolate() const;
 		
+		/*******************************************************************//*!
+		*
+		*	@brief Creates the isolate and its context with KaTeX loaded.
+		*
+		***********************************************************************/
+		
+		void _start();
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Releases all handles and disposes of the isolate.
+		*
+		***********************************************************************/
+		
+		void _stop();
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Recycles the isolate if recycle-renders or recycle-heap
+		*		   was reached.
+		*
+		***********************************************************************/
+		
+		void _recycle_if_due();
+		
 		/*******************************************************************//*!
 		*
 		*	@brief Compiles and executes JavaScript code via the V8 engine.
@@ -195,39 +311,85 @@ namespace Markdown
 		
 		v8::Local<v8::Value> _run(const std::string& source,
 								  const v8::Local<v8::Context>& context) const;
-
+		
 		/*******************************************************************//*!
 		*
-		*	@brief Retrieves the JavaScript for calling KaTeX.
+		*	@brief Executes compiled JavaScript in a context.
+		*
+		*	@param script The compiled script.
 		*
-		*	@details Handles determining whether to use display-math depending
-		*			 one the display-mode flag in the configuration and the
-		*			 display_math parameter passed to the render() method.
+		*	@param context The context in which to execute the script.
 		*
-		*	@param	expression A LaTeX expression.
+		*	@return Any return value of the execution.
 		*
-		*	@param	display_math The display_math parameter for this expression.
+		*	@throws ParseException If there was an exception in the JS
+		*						   environment.
 		*
 		***********************************************************************/
+		
+		v8::Local<v8::Value> _execute(const v8::Local<v8::Script>& script,
+									  const v8::Local<v8::Context>& context) const;
 
-		std::string _get_javascript(const std::string& expression,
-									bool display_math) const;
+		/*******************************************************************//*!
+		*
+		*	@brief Calls a JavaScript function.
+		*
+		*	@param function The function.
+		*
+		*	@param arguments The arguments to the function.
+		*
+		*	@param context The context in which to call the function.
+		*
+		*	@return The return value of the function.
+		*
+		*	@throws ParseException If the function threw.
+		*
+		*	@throws TimeoutException If the deadline expired during the
+		*			call (the watchdog terminates the isolate's execution).
+		*
+		***********************************************************************/
+		
+		v8::Local<v8::Value> _call(const v8::Local<v8::Function>& function,
+								   std::vector<v8::Local<v8::Value>> arguments,
+								   const v8::Local<v8::Context>& context) const;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Creates a V8 string.
+		*
+		*	@details The string is passed as is (i.e. needs no escaping), as
+		*			 it is not embedded in JavaScript source.
+		*
+		*	@param string The UTF-8 string.
+		*
+		***********************************************************************/
+		
+		v8::Local<v8::String> _new_string(const std::string& string) const;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Looks up katex.renderToString and creates its options.
+		*
+		*	@details Called whenever KaTeX was (re)loaded into the context.
+		*
+		*	@param context The engine's context.
+		*
+		***********************************************************************/
+		
+		void _bind_katex(const v8::Local<v8::Context>& context);
 		
 		/*******************************************************************//*!
 		*
-		*	@brief Escapes backslashes and whitespace in the LaTeX source.
+		*	@brief Returns the JavaScript helper rendering a batch.
 		*
-		*	@details The problem is that even though you may escape backslashes
-		*			 in the string you pass to the Latex instance, those
-		*			 backlashes then have to again be escaped for the JavaScript
-		*			 source (as they are simply backslashes for the JS
-		*			 environment otherwise, which initiate escape sequences).
+		*	@details The helper is compiled on first use and kept in a
+		*			 persistent handle.
 		*
-		*	@return The escaped LaTeX string.
+		*	@param context The engine's context.
 		*
 		***********************************************************************/
 		
-		std::string _escape(std::string source) const;
+		v8::Local<v8::Function> _batch_function(const v8::Local<v8::Context>& context);
 		
 		/*******************************************************************//*!
 		*
@@ -235,7 +397,8 @@ namespace Markdown
 		*
 		*	@details The KaTeX library is loaded and executed in the current
 		*			 V8 context, such that subsequent code executed in that
-		*			 environment can access the KaTeX library.
+		*			 environment can access the KaTeX library. Compiles via
+		*			 the CodeCache if code-cache is enabled.
 		*
 		*	@param	context A V8 context object.
 		*
@@ -245,8 +408,18 @@ namespace Markdown
 		
 		std::string _handle_error(const std::string& expression) const;
 		
-		/*! A instance of the Allocator struct for the V8 engine. */
-		mutable Allocator _allocator;
+		/*******************************************************************//*!
+		*
+		*	@brief Renders every expression as an error, e.g. once the
+		*		   deadline expired.
+		*
+		***********************************************************************/
+		
+		std::vector<std::string>
+		_handle_errors(const std::vector<expression_t>& expressions) const;
+		
+		/*! The snapshot the isolate was created from (if any). */
+		std::shared_ptr<const Snapshot> _snapshot;
 		
 		/*! The virtual environment in which the V8 runs. */
 		v8::Isolate* _isolate;
@@ -256,9 +429,30 @@ namespace Markdown
 		    with the V8 engine. */
 		v8::UniquePersistent<v8::Context> _persistent_context;
 		
+		/*! katex.renderToString. */
+		v8::UniquePersistent<v8::Function> _persistent_render;
+		
+		/*! The options for katex.renderToString, by display-mode. */
+		v8::UniquePersistent<v8::Object> _persistent_options[2];
+		
+		/*! The JavaScript helper rendering a batch (compiled on first use). */
+		v8::UniquePersistent<v8::Function> _persistent_batch;
+		
 		/*! The path to the katex directory. */
 		std::string _katex_path;
 		
+		/*! The hash of katex.min.js (computed on first use). */
+		mutable std::string _fingerprint;
+		
+		/*! The expressions rendered since the isolate was created. */
+		std::size_t _renders;
+		
+		/*! The value of _renders at which to measure the heap next. */
+		std::size_t _next_heap_check;
+		
+		/*! The number of times the isolate was recycled. */
+		std::size_t _recycles;
+		
 	};
 	
 }
@@ -0,0 +1,184 @@
+/***************************************************************************//*!
+*
+*	@file markdown-native-math.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_NATIVE_MATH_HPP
+#define MARKDOWN_NATIVE_MATH_HPP
+
+#include "markdown-abstract-math.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief Renders math to MathML without a JavaScript engine.
+	*
+	*	@details Converts the common subset of LaTeX (fractions, roots,
+	*			 sub- and superscripts, large operators, Greek letters and
+	*			 symbols, \\left/\\right delimiters, accents, fonts such
+	*			 as \\mathbb and \\mathcal, text and the matrix, cases and
+	*			 aligned environments) to presentation MathML, which
+	*			 browsers lay out themselves. Equations that use anything
+	*			 else are rendered by a fallback engine (typically Math,
+	*			 i.e. KaTeX), one batch per batch, such that a MathPool
+	*			 still renders them in parallel. The fallback is created
+	*			 on first use, so documents the native engine covers
+	*			 entirely never start V8.
+	*
+	*			 Configuration (key : values [default]):
+	*			 + all-display-math	: (true | false) [false]
+	*			 + throw-on-error	: (true | false) [true]
+	*			 + error-color		: (#hex-color) 	 [#CC0000]
+	*			 + log-errors		: (true | false) [true]
+	*
+	*			 The settings are passed on to the fallback. Without a
+	*			 fallback, unsupported equations are handled like KaTeX's
+	*			 parse errors.
+	*
+	***************************************************************************/
+
+	class NativeMath : public AbstractMath
+	{
+	public:
+
+		/*! Creates the fallback engine. */
+		using factory_t = std::function<std::unique_ptr<AbstractMath>()>;
+
+		/*! The default settings for this math engine. */
+		static const Configurable::settings_t default_settings;
+
+		/*! Identifies the converter (bumped whenever its output changes). */
+		static const std::string version;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a new NativeMath.
+		*
+		*	@param fallback The factory for the fallback engine (may be
+		*					empty, for no fallback).
+		*
+		*	@param fallback_fingerprint The fingerprint the fallback
+		*								engine will have.
+		*
+		*	@param settings The configuration-settings for this engine.
+		*
+		***********************************************************************/
+
+		NativeMath(const factory_t& fallback = factory_t(),
+				   const std::string& fallback_fingerprint = std::string(),
+				   const Configurable::settings_t& settings = default_settings);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Renders math to MathML, or with the fallback.
+		*
+		*	@param expression A string containing a LaTeX expression.
+		*
+		*	@param display_math Whether to use display-math for the expression.
+		*
+		*	@return A <span> containing the <math> element.
+		*
+		*	@throws ParseException If the expression could not be rendered
+		*			and throw-on-error is set.
+		*
+		***********************************************************************/
+
+		virtual std::string render(const std::string& expression,
+								   bool display_math = false) override;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Renders many expressions, passing the unsupported ones
+		*		   to the fallback as one batch.
+		*
+		*	@param expressions The expressions to render.
+		*
+		*	@return The HTML for each expression, in the same order.
+		*
+		***********************************************************************/
+
+		virtual std::vector<std::string>
+		render(const std::vector<expression_t>& expressions) override;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the converter's version and the fallback's
+		*		   fingerprint.
+		*
+		***********************************************************************/
+
+		virtual std::string fingerprint() const override;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Lets the fallback (if it was created) clean up.
+		*
+		***********************************************************************/
+
+		virtual void idle() override;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Converts a LaTeX expression to a <math> element.
+		*
+		*	@param expression A string containing a LaTeX expression.
+		*
+		*	@param display_math Whether to use display-math for the expression.
+		*
+		*	@param mathml The string to store the MathML in.
+		*
+		*	@return True if the expression is supported, else false (and
+		*			mathml is left unchanged).
+		*
+		***********************************************************************/
+
+		static bool convert(const std::string& expression,
+							bool display_math,
+							std::string& mathml);
+
+	private:
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the fallback (creating it if necessary), with
+		*		   this engine's settings.
+		*
+		*	@return The fallback, or nullptr if there is none.
+		*
+		***********************************************************************/
+
+		AbstractMath* _fallback_engine();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Renders an unsupported expression without a fallback.
+		*
+		*	@param expression The expression.
+		*
+		*	@return The expression in the error-color.
+		*
+		***********************************************************************/
+
+		std::string _handle_error(const std::string& expression) const;
+
+		/*! The factory for the fallback. */
+		factory_t _factory;
+
+		/*! The fallback (created on first use). */
+		std::unique_ptr<AbstractMath> _fallback;
+
+		/*! The fingerprint of the fallback. */
+		std::string _fallback_fingerprint;
+	};
+}
+
+#endif /* MARKDOWN_NATIVE_MATH_HPP */
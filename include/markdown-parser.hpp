@@ -10,7 +10,10 @@
 #define MARKDOWNPP_PARSER_HPP
 
 #include "markdown-configurable.hpp"
+#include "markdown-deadline.hpp"
 
+#include <cstddef>
+#include <iosfwd>
 #include <memory>
 #include <stdexcept>
 #include <string>
@@ -21,6 +24,8 @@ namespace Markdown
 	class AbstractMarkdown;
 	class AbstractMath;
 	class Code;
+	class Highlighter;
+	class Macros;
 	
 	/***********************************************************************//*!
 	*
@@ -28,11 +33,14 @@ namespace Markdown
 	*
 	*	@param markdown The markdown to render.
 	*
+	*	@param deadline The Deadline by which to finish (see Parser).
+	*
 	*	@return A HTML snippet without any enclosing <html> or <body> tags.
 	*
 	***************************************************************************/
 
-	std::string snippet(const std::string& markdown);
+	std::string snippet(const std::string& markdown,
+						const Deadline& deadline = Deadline());
 
 	/***********************************************************************//*!
 	*
@@ -45,6 +53,45 @@ namespace Markdown
 	*			 + code-style		: (see themes/code/style) [solarized-dark]
 	*			 + include-mode		: (embed|local|network) [network]
 	*			 + file-protocol	: (true | false) [false]
+	*			 + concurrent-math	: (true | false) [true]
+	*			 + highlight-mode	: (client | server) [client]
+	*			 + math-engine		: (katex | native | quickjs) [katex]
+	*			 + math-macros		: (LaTeX definitions, see Macros) []
+	*
+	*			 With concurrent-math, the markdown of a document with
+	*			 math is rendered on another thread while its equations
+	*			 are rendered, such that a document takes about as long
+	*			 as the slower of the two.
+	*
+	*			 With the client highlight-mode, documents include
+	*			 highlight.js, which highlights code blocks in the browser.
+	*			 With the server one, code blocks are highlighted when
+	*			 rendering (see Highlighter) and documents include only
+	*			 the code-style's stylesheet.
+	*
+	*			 The math-engine selects the default math engine: Math
+	*			 (KaTeX) or NativeMath, which converts most equations to
+	*			 MathML itself and renders only the others with KaTeX.
+	*			 quickjs (QuickJSMath) is only available in builds with
+	*			 MARKDOWNPP_QUICKJS defined.
+	*
+	*			 The math-macros are expanded in every equation before it
+	*			 is rendered. A document may add to (or redefine) them in
+	*			 front matter: a block of `key: value` lines between two
+	*			 `---` lines at its very beginning, whose `macros` value
+	*			 (on the key's line or the indented lines after it) is a
+	*			 preamble of definitions. Front matter that defines macros
+	*			 is not rendered, other front matter is left as it is.
+	*			 The setting's macros are parsed once (until the setting
+	*			 changes), a document's when it is rendered.
+	*
+	*			 Renders take an optional Deadline, which is checked
+	*			 between stages: before the markdown of a document (or
+	*			 of each streamed chunk) is rendered, a TimeoutException
+	*			 is thrown if it expired. The math engine renders the
+	*			 equations it has not finished by then as errors, and
+	*			 code is no longer highlighted. The markdown-engine
+	*			 itself cannot be interrupted.
 	*
 	***************************************************************************/
 	
@@ -52,6 +99,10 @@ namespace Markdown
 	{
 	public:
 		
+		using Configurable::configure;
+		
+		using Configurable::settings;
+		
 		/*! The default settings for a Parser. */
 		static const Configurable::settings_t default_settings;
 		
@@ -59,6 +110,10 @@ namespace Markdown
 		*
  		*	@brief Constructs a new Parser instance.
 		*
+		*	@details The default engines are created on first use; the
+		*			 math engine (and V8) only for the first document
+		*			 that contains math.
+		*
 		*	@param root The root path for the themes/ and katex/ folders.
 		*
 		*	@param stylesheet_path The path to a custom stylesheet.
@@ -113,6 +168,9 @@ namespace Markdown
 		*
 		*	@brief Move-constructs the parser.
 		*
+		*	@details Takes over the other parser's engines and state, without
+		*			 creating any engines.
+		*
 		*	@param other The other Parser object.
 		*
 		***********************************************************************/
@@ -162,6 +220,50 @@ namespace Markdown
 		
 		virtual ~Parser();
 		
+		/*******************************************************************//*!
+		*
+		*	@brief Configures a key-value pair.
+		*
+		*	@details Invalidates the cached <head> if the value changed.
+		*
+		*	@param key The key to configure.
+		*
+		*	@param value The value for the key.
+		*
+		***********************************************************************/
+		
+		virtual void configure(const std::string& key,
+							   const std::string& value) override;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Retrieves a value for a key.
+		*
+		*	@details Invalidates the cached <head>, since the value may be
+		*			 changed through the reference.
+		*
+		*	@param key The key to configure.
+		*
+		*	@return The value, as an std::string.
+		*
+		***********************************************************************/
+		
+		virtual std::string& operator[](const std::string& key) override;
+		
+		using Configurable::operator[];
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Sets the settings entirely.
+		*
+		*	@details Invalidates the cached <head>.
+		*
+		*	@param settings The new settings.
+		*
+		***********************************************************************/
+		
+		virtual void settings(const settings_t& settings) override;
+		
 		/*******************************************************************//*!
 		*
 		*	@brief Renders markdown and returns a __full__ HTML document.
@@ -169,11 +271,48 @@ namespace Markdown
 		*	@details The rendered HTML is a complete web-page with included
 		*			 or embedded CSS and JavaScript files.
 		*
+		*	@param markdown The markdown to render.
+		*
+		*	@param deadline The Deadline by which to finish.
+		*
 		*	@return A full HTML document with the rendered markdown.
 		*
+		*	@throws TimeoutException If the deadline expired before the
+		*			markdown was rendered.
+		*
 		***********************************************************************/
 		
-		virtual std::string render(std::string markdown);
+		virtual std::string render(std::string markdown,
+								   const Deadline& deadline = Deadline());
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Renders markdown from a stream to a __full__ HTML document.
+		*
+		*	@details The <head> is written (and flushed) before any input is
+		*			 read. The input is then read line by line and rendered
+		*			 in chunks of roughly _chunk_size bytes, which are split
+		*			 at blank lines between top-level blocks (never inside
+		*			 fenced code, display-math or indented continuations
+		*			 and never right before a list item), such that memory
+		*			 use stays bounded regardless of the input size. Note
+		*			 that reference-style links and footnotes are resolved
+		*			 per chunk.
+		*
+		*	@param input The stream to read the markdown from.
+		*
+		*	@param output The stream to write the HTML to.
+		*
+		*	@param deadline The Deadline by which to finish.
+		*
+		*	@throws TimeoutException If the deadline expired before a
+		*			chunk was rendered (leaving the output incomplete).
+		*
+		***********************************************************************/
+		
+		virtual void render(std::istream& input,
+							std::ostream& output,
+							const Deadline& deadline = Deadline());
 		
 		/*******************************************************************//*!
 		*
@@ -183,31 +322,41 @@ namespace Markdown
 		*
 		*	@param path The path of the file containing the markdown.
 		*
+		*	@param deadline The Deadline by which to finish.
+		*
 		*	@return A full HTML document with the rendered markdown.
 		*
-		*	@see render(std::string)
+		*	@see render(std::string, const Deadline&)
 		*
 		***********************************************************************/
 		
-		virtual std::string render_file(const std::string& path);
+		virtual std::string render_file(const std::string& path,
+										const Deadline& deadline = Deadline());
 
 		/*******************************************************************//*!
 		*
 		*	@brief Renders a markdown file to an HTML file.
 		*
-		*	@details Writes the output of render_file() to the destination.
-		*			 Erases any previous contents of the destination file.
+		*	@details Renders the file as a whole (unlike render(std::istream&,
+		*			 std::ostream&), such that reference-style links and
+		*			 footnotes resolve across the document) and writes the
+		*			 result to the destination, erasing any previous contents.
 		*
 		*	@param path The path of the file containing the markdown.
 		*
 		*	@param destination The path where the output should be written to.
 		*
-		*	@see render_file(std::string)
+		*	@param deadline The Deadline by which to finish.
+		*
+		*	@throws FileException If the destination could not be written.
+		*
+		*	@see render_file(const std::string&, const Deadline&)
 		*
 		***********************************************************************/
 		
 		virtual void render_file(const std::string& path,
-								 const std::string& destination);
+								 const std::string& destination,
+								 const Deadline& deadline = Deadline());
 		
 		/*******************************************************************//*!
 		*
@@ -215,11 +364,17 @@ namespace Markdown
 		*
 		*	@param markdown The markdown to render.
 		*
+		*	@param deadline The Deadline by which to finish.
+		*
 		*	@return A HTML snippet without any enclosing <html> or <body> tags.
 		*
+		*	@throws TimeoutException If the deadline expired before the
+		*			markdown was rendered.
+		*
 		***********************************************************************/
 		
-		virtual std::string snippet(std::string markdown) const;
+		virtual std::string snippet(std::string markdown,
+									const Deadline& deadline = Deadline()) const;
 
 		/*******************************************************************//*!
 		*
@@ -360,6 +515,47 @@ namespace Markdown
 		
 		virtual AbstractMath& math();
 		
+		/*******************************************************************//*!
+		*
+		*	@brief Lets the engines clean up between documents.
+		*
+		*	@details Calls idle() on the math-engine if it exists, without
+		*			 creating it (unlike math()).
+		*
+		***********************************************************************/
+		
+		virtual void idle();
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Returns a hash of everything that affects the output.
+		*
+		*	@details Covers the settings of the Parser and of its markdown
+		*			 and math engines, the math engine's fingerprint (e.g.
+		*			 the KaTeX version), the root and stylesheet paths, the
+		*			 custom CSS and the <head> (which holds the contents of
+		*			 embedded themes, such that edits to them are noticed).
+		*			 Two renders of the same markdown with equal fingerprints
+		*			 produce the same HTML.
+		*
+		*	@return The hash as hexadecimal digits.
+		*
+		***********************************************************************/
+		
+		virtual std::string fingerprint();
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the paths of the files included in the <head>.
+		*
+		*	@details These are the stylesheets, scripts and URL files of the
+		*			 themes and the custom stylesheet, i.e. the files whose
+		*			 modification changes every rendered document.
+		*
+		***********************************************************************/
+		
+		std::vector<std::string> assets();
+		
 	protected:
 		
 		/*! A container for equations. */
@@ -384,6 +580,33 @@ namespace Markdown
 		/*! A <style> HTML tag. */
 		static const tag_t _style;
 		
+		/*! The size after which streamed markdown is rendered at the next
+		    block boundary (see render(std::istream&, std::ostream&)). */
+		static const std::size_t _chunk_size;
+		
+		/*! The marker for inline-math in the markdown (brackets the index). */
+		static const tag_t _inline_marker;
+		
+		/*! The marker for display-math in the markdown (brackets the index). */
+		static const tag_t _display_marker;
+		
+		/*! An asset (path and inclusion kind) the <head> was built from. */
+		using asset_t = std::pair<std::string, std::string>;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the document up to and including the <body> tag.
+		*
+		*	@details The <head> depends only on the markdown-style,
+		*			 code-style, include-mode, file-protocol and enable-code
+		*			 settings, the root path, the stylesheet, the custom CSS
+		*			 and the contents of the included assets. It is therefore
+		*			 built once and only rebuilt when one of those changes.
+		*
+		***********************************************************************/
+		
+		virtual const std::string& _head();
+		
 		/*******************************************************************//*!
 		*
 		*	@brief Handles retrieval of a CSS stylesheet.
@@ -414,55 +637,275 @@ namespace Markdown
 		
 		virtual std::string _get_script(const std::string& path) const;
 		
+		/*******************************************************************//*!
+		*
+		*	@brief Retrieves the contents of a file wrapped in an HTML tag.
+		*
+		*	@details Goes through the process-wide AssetCache, such that the
+		*			 file is only read (and, for embedded scripts, escaped)
+		*			 again once it changed on disk.
+		*
+		*	@param path The path of the file.
+		*
+		*	@param tag The tag to wrap the contents in.
+		*
+		***********************************************************************/
+		
+		virtual std::string _get_asset(const std::string& path,
+									   const tag_t& tag) const;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Renders a view of markdown to an HTML snippet.
+		*
+		*	@details The implementation of snippet(), which renders straight
+		*			 from a (e.g. memory-mapped) buffer without copying it.
+		*
+		*	@param markdown A pointer to the markdown (not null-terminated).
+		*
+		*	@param size The size of the markdown.
+		*
+		*	@param deadline The Deadline by which to finish.
+		*
+		*	@param macros The macros to expand in the equations.
+		*
+		*	@return A HTML snippet without any enclosing <html> or <body> tags.
+		*
+		*	@throws TimeoutException If the deadline expired before the
+		*			markdown was rendered.
+		*
+		***********************************************************************/
+		
+		virtual std::string _snippet(const char* markdown,
+									 std::size_t size,
+									 const Deadline& deadline,
+									 const Macros& macros) const;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Renders markdown with math to HTML.
+		*
+		*	@param markdown A pointer to the markdown (not null-terminated).
+		*
+		*	@param size The size of the markdown.
+		*
+		*	@param deadline The Deadline by which to finish.
+		*
+		*	@param macros The macros to expand in the equations.
+		*
+		*	@return The HTML (with code blocks not yet highlighted).
+		*
+		*	@throws TimeoutException If the deadline expired before the
+		*			markdown was rendered.
+		*
+		***********************************************************************/
+		
+		virtual std::string _render_with_math(const char* markdown,
+											  std::size_t size,
+											  const Deadline& deadline,
+											  const Macros& macros) const;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Reads the macros of a document's front matter and skips
+		*		   the front matter if it defines any.
+		*
+		*	@details Front matter starts with a `---` line and ends with a
+		*			 `---` or `...` line. In between, every line must be
+		*			 blank, a `# comment`, a `key: value` or an indented
+		*			 continuation of the last key's value, otherwise the
+		*			 document has no front matter.
+		*
+		*	@param markdown A pointer to the markdown, advanced past the
+		*			front matter if it defines macros.
+		*
+		*	@param size The size of the markdown, reduced accordingly.
+		*
+		*	@return The math-macros with the front matter's macros added.
+		*
+		*	@throws ParseException If the macros are malformed.
+		*
+		***********************************************************************/
+		
+		std::shared_ptr<const Macros> _front_matter(const char*& markdown,
+													std::size_t& size) const;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the macros of the math-macros setting.
+		*
+		*	@details Parsed again only when the setting changed.
+		*
+		*	@throws ParseException If the macros are malformed.
+		*
+		***********************************************************************/
+		
+		std::shared_ptr<const Macros> _math_macros() const;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Highlights the code blocks of rendered HTML in-place.
+		*
+		*	@details Replaces each <pre><code> block by highlight.js' markup
+		*			 for it, with the language of the block (if any).
+		*
+		*	@param html The rendered markdown.
+		*
+		***********************************************************************/
+		
+		virtual void _highlight_code(std::string& html) const;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Reverts the HTML-escaping of a code block's text.
+		*
+		*	@param escaped The escaped text.
+		*
+		*	@return The text.
+		*
+		***********************************************************************/
+		
+		static std::string _unescape_html(const std::string& escaped);
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the validated highlight-mode.
+		*
+		*	@throws ConfigurationValueException If it is neither client
+		*										nor server.
+		*
+		***********************************************************************/
+		
+		std::string _highlight_mode() const;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the validated math-engine.
+		*
+		*	@throws ConfigurationValueException If it is not one of katex,
+		*										native or (if built with it)
+		*										quickjs.
+		*
+		***********************************************************************/
+		
+		std::string _math_engine_name() const;
+		
 		/*******************************************************************//*!
 		*
 		*	@brief Extracts LaTeX equations from Markdown source.
 		*
-		*	@details LaTeX equations are extracted one-by-one and replaced
-		*			 with numeric markers. After the resulting Markdown is
+		*	@details The markdown is scanned once, from left to right, and
+		*			 copied into a new buffer in which every LaTeX equation
+		*			 is replaced with a marker (its index, bracketed by
+		*			 control characters that cannot appear in the markdown
+		*			 and that the markdown-engine passes through untouched,
+		*			 see _inline_marker and _display_marker). Stray marker
+		*			 characters in the source are dropped. Fenced code blocks,
+		*			 inline code spans and backslash-escaped characters are
+		*			 copied verbatim, such that dollar signs in code are never
+		*			 mistaken for math. After the resulting Markdown is
 		*			 rendered by the Markdown-engine and the LaTeX equations
-		*			 have been rendered by the Math-engine, the numeric markers
-		*			 are replaced with their respective rendered LaTeX (HTML).
+		*			 have been rendered by the Math-engine, the markers are
+		*			 replaced with their respective rendered LaTeX (HTML).
+		*			 Identical equations (of the same kind) are extracted
+		*			 once and share a marker, such that each is rendered
+		*			 and stored only once.
+		*
+		*	@param source The markdown from which to extract.
 		*
-		*	@param markdown The markdown from which to extract.
+		*	@param size The size of the source.
+		*
+		*	@param markdown The string to write the substituted markdown to.
 		*
 		*	@return An extraction_t with first being the inline-math and
 		*			second being the display-math.
 		*
 		***********************************************************************/
 		
-		virtual extraction_t _extract_math(std::string& markdown) const;
+		virtual extraction_t _extract_math(const char* source,
+										   std::size_t size,
+										   std::string& markdown) const;
 		
 		/*******************************************************************//*!
 		*
-		*	@brief Extracts a pattern-matching string from a markdown source.
+		*	@brief Finds the end of a fenced code block.
+		*
+		*	@details A fence is a line starting with at most three spaces
+		*			 followed by at least three backticks or tildes. The
+		*			 block is closed by a line with at least as many of the
+		*			 same fence character, or by the end of the document.
+		*
+		*	@param source The markdown source.
 		*
-		*	@param markdown The markdown source from which to extract.
+		*	@param size The size of the source.
 		*
-		*	@param pattern The regex pattern extracted strings should match.
+		*	@param position The start of the line to check.
+		*
+		*	@return The position after the closing fence line, or position
+		*			itself if no code fence begins at that line.
 		*
 		***********************************************************************/
 		
-		virtual equations_t _extract(std::string& markdown,
-							 const std::string& pattern) const;
+		virtual std::size_t _skip_code_fence(const char* source,
+											 std::size_t size,
+											 std::size_t position) const;
 		
 		/*******************************************************************//*!
 		*
-		*	@brief Converts math equations one-by-one.
+		*	@brief Finds the end of an inline code span.
+		*
+		*	@details A code span opened by a run of N backticks is closed by
+		*			 the next run of exactly N backticks within the same
+		*			 paragraph (code spans never cross a blank line).
+		*
+		*	@param source The markdown source.
+		*
+		*	@param size The size of the source.
+		*
+		*	@param position The position of the opening backtick run.
+		*
+		*	@return The position after the closing backtick run or, if the
+		*			span is never closed, after the opening run.
+		*
+		***********************************************************************/
+		
+		virtual std::size_t _skip_code_span(const char* source,
+											std::size_t size,
+											std::size_t position) const;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Converts math equations in one batch.
 		*
 		*	@details Operates in-place and replaces LaTeX equations with the
 		*			 rendered HTML (for each index in each set of equations).
+		*			 All equations are passed to the math-engine at once,
+		*			 such that it may render them in parallel.
 		*
 		*	@param equations The equations to render with the math-engine.
 		*
+		*	@param deadline The Deadline the math-engine renders by (the
+		*			engine's deadline is reset afterwards).
+		*
+		*	@param macros The macros to expand in the equations first
+		*			(equations they cannot be expanded in are left as
+		*			they are, for the engine to report).
+		*
 		***********************************************************************/
 		
-		virtual void _convert_math(extraction_t& equations) const;
+		virtual void _convert_math(extraction_t& equations,
+								   const Deadline& deadline,
+								   const Macros& macros) const;
 		
 		/*******************************************************************//*!
 		*
 		*	@brief Re-inserts the rendered math into the destination HTML.
 		*
+		*	@details The markers are spliced out in a single pass over the
+		*			 HTML, which is written into one output buffer whose
+		*			 size is reserved from the lengths of the rendered math.
+		*			 A marker may occur many times (see _extract_math).
+		*
 		*	@param html The rendered markdown.
 		*
 		*	@param equations The equations to insert.
@@ -476,6 +919,8 @@ namespace Markdown
 		*
 		*	@brief Reads a file and returns its contents.
 		*
+		*	@details Trailing whitespace is stripped.
+		*
 		*	@param path The path to the file to read.
 		*
 		***********************************************************************/
@@ -531,6 +976,32 @@ namespace Markdown
 		virtual std::string
 		_join_paths(const std::vector<std::string>& paths) const;
 		
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the markdown-engine, creating the default one
+		*		   if there is none yet.
+		*
+		***********************************************************************/
+		
+		AbstractMarkdown& _markdown_engine() const;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the math-engine, creating the default one (a Math
+		*		   engine for the root's katex folder) if there is none yet.
+		*
+		***********************************************************************/
+		
+		AbstractMath& _math_engine() const;
+		
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the path of the root's katex folder.
+		*
+		***********************************************************************/
+		
+		std::string _katex_path() const;
+		
 		/*******************************************************************//*!
 		*
 		*	@brief Escapes </script> tags in the contents of a <script> tag.
@@ -552,17 +1023,35 @@ namespace Markdown
 		/*! The root directory path. */
 		std::string _root;
 		
-		/*! The markdown-engine in use. */
-		std::unique_ptr<AbstractMarkdown> _markdown;
+		/*! The markdown-engine in use (created on first use). */
+		mutable std::unique_ptr<AbstractMarkdown> _markdown;
 
-		/*! The math-engine in use. */
-		std::unique_ptr<AbstractMath> _math;
+		/*! The math-engine in use (created on first use). */
+		mutable std::unique_ptr<AbstractMath> _math;
 		
 		/*! The stylesheet path. */
 		std::string _stylesheet;
 		
 		/*! The accumulated custom CSS. */
 		std::string _custom_css;
+		
+		/*! The cached document head (see _head()). */
+		std::string _head_cache;
+		
+		/*! Whether _head_cache must be rebuilt. */
+		bool _head_stale;
+		
+		/*! The assets read while building the head. */
+		mutable std::vector<asset_t> _head_assets;
+		
+		/*! The highlighter for server-side highlighting (created on first use). */
+		mutable std::unique_ptr<Highlighter> _highlighter;
+		
+		/*! The math-macros setting _macros was parsed from. */
+		mutable std::string _macros_preamble;
+		
+		/*! The parsed math-macros (see _math_macros()). */
+		mutable std::shared_ptr<const Macros> _macros;
 	};
 }
 
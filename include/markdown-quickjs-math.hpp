@@ -0,0 +1,213 @@
+/***************************************************************************//*!
+*
+*	@file markdown-quickjs-math.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_QUICKJS_MATH_HPP
+#define MARKDOWN_QUICKJS_MATH_HPP
+
+#ifdef MARKDOWNPP_QUICKJS
+
+#include "markdown-abstract-math.hpp"
+
+#include <cstddef>
+#include <quickjs.h>
+#include <string>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief Renders Math to HTML with KaTeX on QuickJS.
+	*
+	*	@details A lighter alternative to Math (only built with
+	*			 MARKDOWNPP_QUICKJS defined, i.e. `make QUICKJS=1`): an
+	*			 engine takes a few MiB instead of a V8 isolate's tens of
+	*			 MiB and starts in milliseconds, at the cost of slower
+	*			 rendering (QuickJS has no JIT). Suited for many engines
+	*			 per core, e.g. in a large MathPool.
+	*			 Configuration (key : values [default]):
+	*			 + all-display-math	: (true | false) [false]
+	*			 + throw-on-error	: (true | false) [true]
+	*			 + error-color		: (#hex-color) 	 [#CC0000]
+	*			 + log-errors		: (true | false) [true]
+	*			 + bytecode			: (true | false) [true]
+	*			 + memory-limit		: (MiB, 0 = none) [0]
+	*
+	*			 With bytecode enabled, KaTeX is compiled to QuickJS
+	*			 bytecode once and stored in the katex folder (see
+	*			 bytecode_file_name), from which later engines (also of
+	*			 later processes) load it instead of parsing katex.min.js.
+	*			 The file is kept in memory, too, for all engines of the
+	*			 process. Bytecode of another KaTeX version is ignored and
+	*			 bytecode QuickJS rejects (e.g. of another QuickJS
+	*			 version) is replaced.
+	*
+	*			 An engine renders the same HTML as a Math engine with the
+	*			 same KaTeX, so both have the same fingerprint and share
+	*			 cached equations.
+	*
+	*			 QuickJS polls the engine's deadline while running KaTeX
+	*			 and aborts once it expired, such that the expression is
+	*			 rendered as an error.
+	*
+	***************************************************************************/
+
+	class QuickJSMath : public AbstractMath
+	{
+	public:
+
+		/*! The default settings for this math engine. */
+		static const Configurable::settings_t default_settings;
+
+		/*! The name of the bytecode file in the katex folder. */
+		static const std::string bytecode_file_name;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a QuickJSMath engine.
+		*
+		*	@param katex_path The path to the katex folder.
+		*
+		*	@param settings The settings for the engine.
+		*
+		*	@throws FileException If KaTeX could not be loaded.
+		*
+		***********************************************************************/
+
+		QuickJSMath(const std::string& katex_path = ".",
+					const Configurable::settings_t& settings = default_settings);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-constructor.
+		*
+		***********************************************************************/
+
+		QuickJSMath(const QuickJSMath& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-assignment operator.
+		*
+		***********************************************************************/
+
+		QuickJSMath& operator=(const QuickJSMath& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Frees the engine's QuickJS runtime.
+		*
+		***********************************************************************/
+
+		~QuickJSMath();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Renders a LaTeX expression to HTML.
+		*
+		*	@param expression The LaTeX expression to render to HTML.
+		*
+		*	@param display_math Whether to use a displaymath environment.
+		*
+		*	@return A HTML snippet without any enclosing <html> or <body> tags.
+		*
+		*	@throws ParseException If KaTeX could not parse the expression
+		*						   and throw-on-error is set.
+		*
+		***********************************************************************/
+
+		virtual std::string render(const std::string& expression,
+								   bool display_math = false) override;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the hash of katex.min.js (as Math does).
+		*
+		***********************************************************************/
+
+		virtual std::string fingerprint() const override;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Collects the runtime's garbage cycles.
+		*
+		***********************************************************************/
+
+		virtual void idle() override;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the bytes the engine's runtime has allocated.
+		*
+		***********************************************************************/
+
+		std::size_t memory_usage() const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the KaTeX path.
+		*
+		***********************************************************************/
+
+		const std::string& katex_path() const noexcept;
+
+	private:
+
+		/*******************************************************************//*!
+		*
+		*	@brief Evaluates KaTeX, from bytecode if possible.
+		*
+		*	@throws FileException If KaTeX could not be loaded.
+		*
+		***********************************************************************/
+
+		void _load_katex();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the message of the pending exception (and clears
+		*		   it).
+		*
+		***********************************************************************/
+
+		std::string _exception() const;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Renders an expression KaTeX could not parse.
+		*
+		*	@param expression The expression.
+		*
+		*	@return The expression in the error-color.
+		*
+		***********************************************************************/
+
+		std::string _handle_error(const std::string& expression) const;
+
+		/*! The runtime (heap) of this engine. */
+		JSRuntime* _runtime;
+
+		/*! The context KaTeX was evaluated in. */
+		JSContext* _context;
+
+		/*! katex.renderToString. */
+		JSValue _render;
+
+		/*! The options for inline and display math (KaTeX only reads them). */
+		JSValue _options[2];
+
+		/*! The path to the katex folder. */
+		std::string _katex_path;
+
+		/*! The hash of katex.min.js (computed on first use). */
+		mutable std::string _fingerprint;
+	};
+}
+
+#endif /* MARKDOWNPP_QUICKJS */
+
+#endif /* MARKDOWN_QUICKJS_MATH_HPP */
@@ -0,0 +1,276 @@
+/***************************************************************************//*!
+*
+*	@file markdown-server.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_SERVER_HPP
+#define MARKDOWN_SERVER_HPP
+
+#include "markdown-configurable.hpp"
+#include "markdown-connection.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Markdown
+{
+	class Parser;
+
+	/***********************************************************************//*!
+	*
+	*	@brief A daemon rendering markdown for Clients over a Unix socket.
+	*
+	*	@details The Server keeps a pool of worker threads, each with its
+	*			 own (warm) Parser from a factory, such that requests do not
+	*			 pay for starting the markdown and math engines. Accepted
+	*			 connections are queued and served by the next free worker,
+	*			 one request after another until the client disconnects.
+	*			 A render request may override settings of the Parser; the
+	*			 previous values are restored after the request. The time
+	*			 to handle each request is recorded in the Statistics.
+	*			 stop() may be called from a signal handler: it stops
+	*			 accepting connections, after which run() serves the
+	*			 requests already received and returns.
+	*			 With a timeout, each render gets a Deadline (see Parser):
+	*			 equations not rendered by then come back as errors, and
+	*			 requests whose markdown was not yet rendered fail, such
+	*			 that no request holds a worker for much longer.
+	*			 Configuration (key : values [default]):
+	*			 + workers		: (number of Parsers, 0 = cores) [0]
+	*			 + backlog		: (pending connections) [64]
+	*			 + log			: 0 | 1 (a line per request on stderr) [0]
+	*			 + timeout		: (ms per render, 0 = none) [0]
+	*
+	***************************************************************************/
+
+	class Server : public Configurable
+	{
+	public:
+
+		/*! The default settings for a Server. */
+		static const Configurable::settings_t default_settings;
+
+		/*! Creates a configured Parser for a worker. */
+		using factory_t = std::function<std::unique_ptr<Parser>()>;
+
+		/*! Latency metrics of the requests handled so far. */
+		struct Statistics
+		{
+			/*! The number of requests. */
+			std::size_t requests;
+
+			/*! The number of requests that failed. */
+			std::size_t errors;
+
+			/*! The mean latency in milliseconds. */
+			double mean;
+
+			/*! The median latency in milliseconds. */
+			double median;
+
+			/*! The 99th percentile of the latency in milliseconds. */
+			double p99;
+
+			/*! The maximum latency in milliseconds. */
+			double maximum;
+
+			/*! Formats the statistics for humans. */
+			std::string to_string() const;
+		};
+
+		/*! The number of most recent latencies the percentiles are taken of. */
+		static const std::size_t latency_window;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a new Server.
+		*
+		*	@param path The path of the Unix domain socket to listen on.
+		*
+		*	@param factory The factory for the workers' Parsers. Called on
+		*				   the worker threads.
+		*
+		*	@param settings The settings for the Server.
+		*
+		*	@throws FileException If the shutdown pipe could not be created.
+		*
+		***********************************************************************/
+
+		Server(const std::string& path,
+			   const factory_t& factory,
+			   const Configurable::settings_t& settings = default_settings);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-constructor.
+		*
+		***********************************************************************/
+
+		Server(const Server& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-assignment operator.
+		*
+		***********************************************************************/
+
+		Server& operator=(const Server& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Destructs the Server.
+		*
+		***********************************************************************/
+
+		~Server();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Serves requests until stop() is called.
+		*
+		*	@details Replaces a stale socket file at the path and removes the
+		*			 socket file again when done.
+		*
+		*	@throws FileException If the socket could not be bound.
+		*
+		*	@throws Whatever the factory throws.
+		*
+		***********************************************************************/
+
+		void run();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Makes run() return once the received requests are served.
+		*
+		*	@details Async-signal-safe.
+		*
+		***********************************************************************/
+
+		void stop() noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the latency metrics of the requests so far.
+		*
+		***********************************************************************/
+
+		Statistics statistics() const;
+
+	private:
+
+		/*******************************************************************//*!
+		*
+		*	@brief The main loop of a worker thread.
+		*
+		*	@param ready Called once the worker's Parser exists (or failed).
+		*
+		***********************************************************************/
+
+		void _work(const std::function<void(std::exception_ptr)>& ready);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Serves the requests of a connection until it is closed.
+		*
+		*	@param parser The worker's Parser.
+		*
+		*	@param connection The connection to a client.
+		*
+		***********************************************************************/
+
+		void _serve(Parser& parser, Connection& connection);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Handles a single request.
+		*
+		*	@param parser The worker's Parser.
+		*
+		*	@param request The request.
+		*
+		*	@return The response.
+		*
+		***********************************************************************/
+
+		Connection::message_t _handle(Parser& parser,
+									  const Connection::message_t& request);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Renders markdown with temporarily overridden settings.
+		*
+		*	@param parser The worker's Parser.
+		*
+		*	@param request The render request (markdown, then key/value pairs).
+		*
+		*	@return The HTML.
+		*
+		***********************************************************************/
+
+		std::string _render(Parser& parser, const Connection::message_t& request);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Records the latency of a request.
+		*
+		*	@param milliseconds The time it took to handle the request.
+		*
+		*	@param success Whether the request succeeded.
+		*
+		***********************************************************************/
+
+		void _record(double milliseconds, bool success);
+
+		/*! The path of the socket. */
+		std::string _path;
+
+		/*! The factory for the workers' Parsers. */
+		factory_t _factory;
+
+		/*! The shutdown pipe, which becomes readable on stop(). */
+		int _wake[2];
+
+		/*! Guards the queue of connections. */
+		std::mutex _mutex;
+
+		/*! Signalled when a connection is queued or the server stops. */
+		std::condition_variable _queued;
+
+		/*! The accepted connections waiting for a worker. */
+		std::deque<Connection> _connections;
+
+		/*! Whether the workers should finish (during a run). */
+		bool _finishing;
+
+		/*! Guards the statistics. */
+		mutable std::mutex _statistics_mutex;
+
+		/*! The number of requests. */
+		std::size_t _requests;
+
+		/*! The number of failed requests. */
+		std::size_t _errors;
+
+		/*! The sum of all latencies. */
+		double _total;
+
+		/*! The maximum latency. */
+		double _maximum;
+
+		/*! The most recent latencies (a ring buffer). */
+		std::vector<double> _latencies;
+	};
+}
+
+#endif /* MARKDOWN_SERVER_HPP */
@@ -0,0 +1,119 @@
+/***************************************************************************//*!
+*
+*	@file markdown-snapshot.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_SNAPSHOT_HPP
+#define MARKDOWN_SNAPSHOT_HPP
+
+#include <memory>
+#include <string>
+#include <v8.h>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief A V8 startup snapshot with KaTeX already evaluated.
+	*
+	*	@details Isolates created from the snapshot deserialize a context in
+	*			 which the katex object already exists, instead of parsing
+	*			 and running katex.min.js. A snapshot file starts with a
+	*			 header holding the V8 version and a hash of katex.min.js,
+	*			 such that snapshots of another V8 or KaTeX are recognized
+	*			 as stale (and ignored) rather than crashing V8.
+	*
+	***************************************************************************/
+
+	class Snapshot
+	{
+	public:
+
+		/*! The name of the snapshot file in the katex directory. */
+		static const std::string file_name;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Creates the snapshot file for a katex directory.
+		*
+		*	@param katex_path The path to the katex directory.
+		*
+		*	@throws FileException If katex.min.js could not be read or the
+		*						  snapshot could not be created or written.
+		*
+		***********************************************************************/
+
+		static void create(const std::string& katex_path);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Loads the snapshot for a katex directory.
+		*
+		*	@details A snapshot is loaded once per version of katex.min.js
+		*			 and shared. Missing or stale snapshots are looked for
+		*			 again on the next call (e.g. once created).
+		*
+		*	@param katex_path The path to the katex directory.
+		*
+		*	@return The snapshot, or null if it is missing or stale.
+		*
+		***********************************************************************/
+
+		static std::shared_ptr<const Snapshot> load(const std::string& katex_path);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns a hash of the katex.min.js in a katex directory.
+		*
+		*	@details The hash is cached until the file changes.
+		*
+		*	@param katex_path The path to the katex directory.
+		*
+		*	@throws FileException If katex.min.js could not be read.
+		*
+		***********************************************************************/
+
+		static std::string katex_hash(const std::string& katex_path);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the blob to pass to v8::Isolate::CreateParams.
+		*
+		***********************************************************************/
+
+		v8::StartupData* blob() const noexcept;
+
+	private:
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a Snapshot from the contents of its blob.
+		*
+		*	@param data The blob.
+		*
+		***********************************************************************/
+
+		Snapshot(std::string data);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the header for snapshots of a KaTeX.
+		*
+		*	@param katex_hash The hash of katex.min.js.
+		*
+		***********************************************************************/
+
+		static std::string _header(const std::string& katex_hash);
+
+		/*! The blob's contents. */
+		std::string _data;
+
+		/*! The blob (pointing into _data). */
+		mutable v8::StartupData _blob;
+	};
+}
+
+#endif /* MARKDOWN_SNAPSHOT_HPP */
@@ -0,0 +1,113 @@
+/***************************************************************************//*!
+*
+*	@file markdown-v8.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_V8_HPP
+#define MARKDOWN_V8_HPP
+
+#include <cstddef>
+#include <memory>
+#include <v8.h>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief The process-wide V8 state (ICU, platform and allocator).
+	*
+	*	@details V8 is initialized on the first call to instance(), i.e.
+	*			 when the first engine is created or a snapshot is made,
+	*			 rather than when the program starts, such that programs
+	*			 (or documents) that never render math do not pay for it.
+	*			 V8 is disposed of when the program exits.
+	*
+	***************************************************************************/
+
+	class V8
+	{
+	public:
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the V8 state, initializing V8 on the first call.
+		*
+		*	@details Thread-safe.
+		*
+		***********************************************************************/
+
+		static V8& instance();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-constructor.
+		*
+		***********************************************************************/
+
+		V8(const V8& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-assignment operator.
+		*
+		***********************************************************************/
+
+		V8& operator=(const V8& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Disposes of V8 and shuts the platform down.
+		*
+		***********************************************************************/
+
+		~V8();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the platform.
+		*
+		***********************************************************************/
+
+		v8::Platform& platform() noexcept;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the allocator for array buffers, shared by all
+		*		   isolates.
+		*
+		***********************************************************************/
+
+		v8::ArrayBuffer::Allocator& allocator() noexcept;
+
+	private:
+
+		/*! Allocates array buffers with malloc. */
+		struct Allocator : public v8::ArrayBuffer::Allocator
+		{
+			virtual void* Allocate(std::size_t length) override;
+
+			virtual void* AllocateUninitialized(std::size_t length) override;
+
+			virtual void Free(void* data, std::size_t) override;
+		};
+
+		/*******************************************************************//*!
+		*
+		*	@brief Initializes ICU, the platform and V8.
+		*
+		***********************************************************************/
+
+		V8();
+
+		/*! The platform. */
+		std::unique_ptr<v8::Platform> _platform;
+
+		/*! The allocator. */
+		Allocator _allocator;
+	};
+}
+
+#endif /* MARKDOWN_V8_HPP */
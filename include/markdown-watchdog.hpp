@@ -0,0 +1,236 @@
+/***************************************************************************//*!
+*
+*	@file markdown-watchdog.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_WATCHDOG_HPP
+#define MARKDOWN_WATCHDOG_HPP
+
+#include "markdown-deadline.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief Calls back once Deadlines expire, e.g. to interrupt a
+	*		   JavaScript engine.
+	*
+	*	@details A single thread watches all Deadlines. It wakes up when
+	*			 the earliest one passes, or every poll_interval while any
+	*			 are watched, since cancelling a Deadline does not notify
+	*			 it. The thread is started on construction (i.e. for the
+	*			 shared Watchdog, on first use). Callbacks are called on
+	*			 the Watchdog's thread with its lock held, so they must
+	*			 be short (like v8::Isolate::TerminateExecution()). Once
+	*			 unwatch() returns, the callback is not running and will
+	*			 not be called.
+	*
+	***************************************************************************/
+
+	class Watchdog
+	{
+	public:
+
+		/*! Called when a Deadline expired. */
+		using callback_t = std::function<void()>;
+
+		/*! How often cancellations are noticed. */
+		static const std::chrono::milliseconds poll_interval;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Watches a Deadline for the lifetime of the Guard.
+		*
+		***********************************************************************/
+
+		class Guard
+		{
+		public:
+
+			/*******************************************************************//*!
+			*
+			*	@brief Starts watching a Deadline.
+			*
+			*	@param deadline The Deadline.
+			*
+			*	@param callback The function to call once it expired.
+			*
+			*	@param watchdog The Watchdog (by default the shared one).
+			*
+			***********************************************************************/
+
+			Guard(const Deadline& deadline,
+				  const callback_t& callback,
+				  Watchdog& watchdog = Watchdog::shared());
+
+			/*******************************************************************//*!
+			*
+			*	@brief Deleted copy-constructor.
+			*
+			***********************************************************************/
+
+			Guard(const Guard& other) = delete;
+
+			/*******************************************************************//*!
+			*
+			*	@brief Deleted copy-assignment operator.
+			*
+			***********************************************************************/
+
+			Guard& operator=(const Guard& other) = delete;
+
+			/*******************************************************************//*!
+			*
+			*	@brief Stops watching (if release() was not called).
+			*
+			***********************************************************************/
+
+			~Guard();
+
+			/*******************************************************************//*!
+			*
+			*	@brief Stops watching.
+			*
+			*	@return Whether the callback was called.
+			*
+			***********************************************************************/
+
+			bool release();
+
+		private:
+
+			/*! The Watchdog. */
+			Watchdog& _watchdog;
+
+			/*! The watch's identifier. */
+			std::size_t _id;
+
+			/*! Whether the watch was released. */
+			bool _released;
+
+			/*! Whether the callback was called. */
+			bool _fired;
+		};
+
+		/*******************************************************************//*!
+		*
+		*	@brief Returns the Watchdog shared by all engines in the process.
+		*
+		***********************************************************************/
+
+		static Watchdog& shared();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a Watchdog and starts its thread.
+		*
+		***********************************************************************/
+
+		Watchdog();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-constructor.
+		*
+		***********************************************************************/
+
+		Watchdog(const Watchdog& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-assignment operator.
+		*
+		***********************************************************************/
+
+		Watchdog& operator=(const Watchdog& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Stops the thread (without calling pending callbacks).
+		*
+		***********************************************************************/
+
+		~Watchdog();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Calls back once a Deadline expired.
+		*
+		*	@param deadline The Deadline.
+		*
+		*	@param callback The function to call (once).
+		*
+		*	@return An identifier for unwatch().
+		*
+		***********************************************************************/
+
+		std::size_t watch(const Deadline& deadline, const callback_t& callback);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Stops watching a Deadline.
+		*
+		*	@param id The identifier returned by watch().
+		*
+		*	@return Whether the callback was called.
+		*
+		***********************************************************************/
+
+		bool unwatch(std::size_t id);
+
+	private:
+
+		/*! A watched Deadline. */
+		struct Watch
+		{
+			/*! The Deadline. */
+			Deadline deadline;
+
+			/*! The function to call once it expired. */
+			callback_t callback;
+		};
+
+		/*******************************************************************//*!
+		*
+		*	@brief The thread's loop.
+		*
+		***********************************************************************/
+
+		void _run();
+
+		/*! Guards everything below. */
+		std::mutex _mutex;
+
+		/*! Signalled when a watch is added or the Watchdog stops. */
+		std::condition_variable _changed;
+
+		/*! The watched Deadlines. */
+		std::map<std::size_t, Watch> _watches;
+
+		/*! The watches whose callbacks were called (until unwatched). */
+		std::set<std::size_t> _fired;
+
+		/*! The next identifier. */
+		std::size_t _next;
+
+		/*! Whether the thread should stop. */
+		bool _stopping;
+
+		/*! The thread. */
+		std::thread _thread;
+	};
+}
+
+#endif /* MARKDOWN_WATCHDOG_HPP */
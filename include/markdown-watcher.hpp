@@ -0,0 +1,161 @@
+/***************************************************************************//*!
+*
+*	@file markdown-watcher.hpp
+*
+*	@author Peter Goldsborough.
+*
+*******************************************************************************/
+
+#ifndef MARKDOWN_WATCHER_HPP
+#define MARKDOWN_WATCHER_HPP
+
+#include <chrono>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+namespace Markdown
+{
+	/***********************************************************************//*!
+	*
+	*	@brief Waits for changes to files and directories (using inotify).
+	*
+	*	@details Files are watched through their parent directory, such that
+	*			 editors which save by writing a new file and renaming it
+	*			 over the old one are noticed as well. Directories are
+	*			 watched recursively, including subdirectories created
+	*			 later on. Bursts of events (e.g. a save that truncates and
+	*			 writes, or a checkout touching many files) are coalesced:
+	*			 wait() only returns once no further event arrived for the
+	*			 debounce interval. Only available on Linux.
+	*
+	***************************************************************************/
+
+	class Watcher
+	{
+	public:
+
+		/*! The set of changed paths. */
+		using changes_t = std::set<std::string>;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Constructs a new Watcher.
+		*
+		*	@param debounce The time to wait for further events.
+		*
+		*	@throws FileException If inotify is not available.
+		*
+		***********************************************************************/
+
+		Watcher(std::chrono::milliseconds debounce = std::chrono::milliseconds(10));
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-constructor.
+		*
+		***********************************************************************/
+
+		Watcher(const Watcher& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Deleted copy-assignment operator.
+		*
+		***********************************************************************/
+
+		Watcher& operator=(const Watcher& other) = delete;
+
+		/*******************************************************************//*!
+		*
+		*	@brief Stops watching.
+		*
+		***********************************************************************/
+
+		~Watcher();
+
+		/*******************************************************************//*!
+		*
+		*	@brief Watches a file or (recursively) a directory.
+		*
+		*	@param path The path to watch. Changes are reported under this
+		*				path (or, for directories, this path joined with the
+		*				path of the changed file relative to it).
+		*
+		*	@throws FileException If the path could not be watched.
+		*
+		***********************************************************************/
+
+		void add(const std::string& path);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Blocks until watched paths changed.
+		*
+		*	@return The changed (created, modified, moved or removed) paths.
+		*
+		*	@throws FileException If reading events failed.
+		*
+		***********************************************************************/
+
+		changes_t wait();
+
+	private:
+
+		/*! A watched directory. */
+		struct Directory
+		{
+			/*! The path of the directory, as it is reported. */
+			std::string path;
+
+			/*! Whether the whole directory is watched (or only some files). */
+			bool recursive;
+
+			/*! The names of the watched files (if not recursive). */
+			std::set<std::string> files;
+		};
+
+		/*******************************************************************//*!
+		*
+		*	@brief Adds an inotify watch for a directory.
+		*
+		*	@param path The path of the directory, as it is reported.
+		*
+		*	@return The directory's entry.
+		*
+		***********************************************************************/
+
+		Directory& _watch(const std::string& path);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Watches a directory and its subdirectories.
+		*
+		*	@param path The path of the directory, as it is reported.
+		*
+		***********************************************************************/
+
+		void _watch_recursively(const std::string& path);
+
+		/*******************************************************************//*!
+		*
+		*	@brief Reads the pending events into a set of changes.
+		*
+		*	@param changes The set of changes to add to.
+		*
+		***********************************************************************/
+
+		void _read(changes_t& changes);
+
+		/*! The time to wait for further events. */
+		std::chrono::milliseconds _debounce;
+
+		/*! The inotify file descriptor. */
+		int _descriptor;
+
+		/*! The watched directories, by watch descriptor. */
+		std::unordered_map<int, Directory> _directories;
+	};
+}
+
+#endif /* MARKDOWN_WATCHER_HPP */
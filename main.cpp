@@ -1,9 +1,364 @@
 #include "markdown-parser.hpp"
 
 #include "include/markdown-abstract-math.hpp"
+#include "include/markdown-batch-renderer.hpp"
+#include "include/markdown-cached-math.hpp"
+#include "include/markdown-client.hpp"
+#include "include/markdown-exceptions.hpp"
+#include "include/markdown-mapped-file.hpp"
+#include "include/markdown-markdown.hpp"
+#include "include/markdown-math.hpp"
+#include "include/markdown-math-cache.hpp"
+#include "include/markdown-math-pool.hpp"
+#include "include/markdown-native-math.hpp"
+#include "include/markdown-quickjs-math.hpp"
+#include "include/markdown-server.hpp"
+#include "include/markdown-snapshot.hpp"
+#include "include/markdown-watcher.hpp"
 
+#include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <glob.h>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace fs = boost::filesystem;
+
+using jobs_t = std::vector<std::pair<std::string, std::string>>;
+
+// Returns path relative to base (path must lie within base)
+fs::path relative_to(const fs::path& path, const fs::path& base)
+{
+	auto component = path.begin();
+	
+	for (const auto& prefix : base)
+	{
+		if (prefix == ".") continue;
+		
+		if (component == path.end() || *component != prefix) break;
+		
+		++component;
+	}
+	
+	fs::path result;
+	
+	for ( ; component != path.end(); ++component) result /= *component;
+	
+	return result;
+}
+
+// Returns whether the input names several files (a directory or a glob)
+bool is_batch(const std::string& input)
+{
+	return fs::is_directory(input) ||
+		   input.find_first_of("*?[") != std::string::npos;
+}
+
+// Returns the directory of a batch input (the directory before any wildcard)
+fs::path base_of(const std::string& input)
+{
+	if (fs::is_directory(input)) return input;
+	
+	auto prefix = input.substr(0, input.find_first_of("*?["));
+	
+	fs::path base = prefix.substr(0, prefix.find_last_of('/') + 1);
+	
+	return base.empty() ? "." : base;
+}
+
+// Collects the markdown files in a directory or matching a glob,
+// mirroring them (as .html files) into the output directory
+jobs_t collect(const std::string& input, std::string output)
+{
+	auto base = base_of(input);
+	
+	std::vector<fs::path> files;
+	
+	if (fs::is_directory(input))
+	{
+		for (fs::recursive_directory_iterator entry(input), end;
+			 entry != end;
+			 ++entry)
+		{
+			auto extension = entry->path().extension();
+			
+			if (fs::is_regular_file(entry->status()) &&
+				(extension == ".md" || extension == ".markdown"))
+			{
+				files.push_back(entry->path());
+			}
+		}
+	}
+	
+	else
+	{
+		glob_t matches;
+		
+		if (::glob(input.c_str(), 0, nullptr, &matches) == 0)
+		{
+			for (std::size_t i = 0; i < matches.gl_pathc; ++i)
+			{
+				if (fs::is_regular_file(matches.gl_pathv[i]))
+				{
+					files.emplace_back(matches.gl_pathv[i]);
+				}
+			}
+		}
+		
+		::globfree(&matches);
+	}
+	
+	// By default, put the HTML files next to the markdown files
+	if (output.empty()) output = base.string();
+	
+	jobs_t jobs;
+	
+	for (const auto& file : files)
+	{
+		auto destination = fs::path(output) / relative_to(file, base);
+		
+		destination.replace_extension(".html");
+		
+		jobs.emplace_back(file.string(), destination.string());
+	}
+	
+	return jobs;
+}
+
+// Renders the input(s) once, then re-renders whatever is affected by
+// changes to the inputs or the parser's assets, until interrupted
+void watch(Markdown::Parser& parser,
+		   const std::string& input,
+		   const std::string& output)
+{
+	auto batch = is_batch(input);
+	
+	std::map<std::string, std::string> jobs;
+	
+	// The watcher reports paths like ./a.md for a.md (lexically,
+	// as files may be gone, and without Boost 1.60's lexically_normal)
+	auto normal = [] (const std::string& path) {
+		fs::path result;
+		
+		for (const auto& part : fs::path(path))
+		{
+			if (part == ".") continue;
+			
+			if (part == ".." &&
+				result.has_filename() &&
+				result != result.root_path() &&
+				result.filename() != "..")
+			{
+				result.remove_filename();
+			}
+			
+			else result /= part;
+		}
+		
+		return result.string();
+	};
+	
+	auto refresh = [&] {
+		jobs.clear();
+		
+		if (! batch) jobs.emplace(normal(input), output);
+		
+		else for (const auto& job : collect(input, output))
+		{
+			jobs.emplace(normal(job.first), job.second);
+		}
+	};
+	
+	auto render = [&] (const std::pair<std::string, std::string>& job) {
+		auto start = std::chrono::steady_clock::now();
+		
+		try
+		{
+			auto directory = fs::path(job.second).parent_path();
+			
+			if (! directory.empty()) fs::create_directories(directory);
+			
+			parser.render_file(job.first, job.second);
+			
+			std::chrono::duration<double, std::milli> elapsed =
+				std::chrono::steady_clock::now() - start;
+			
+			std::cout << "Rendered " << job.second
+					  << " (" << elapsed.count() << " ms)" << std::endl;
+		}
+		
+		catch (const std::exception& error)
+		{
+			std::cerr << "\033[91mError\033[0m: " << error.what() << std::endl;
+		}
+	};
+	
+	Markdown::Watcher watcher;
+	
+	watcher.add(batch ? base_of(input).string() : input);
+	
+	refresh();
+	
+	for (const auto& job : jobs) render(job);
+	
+	auto assets = parser.assets();
+	
+	for (const auto& asset : assets) watcher.add(asset);
+	
+	while (true)
+	{
+		parser.idle();
+		
+		std::set<std::string> changes;
+		
+		for (const auto& path : watcher.wait()) changes.insert(normal(path));
+		
+		bool everything = false;
+		
+		for (const auto& asset : assets)
+		{
+			if (changes.count(normal(asset))) everything = true;
+		}
+		
+		if (everything)
+		{
+			for (const auto& job : jobs) render(job);
+			
+			// A new theme may come with new assets
+			assets = parser.assets();
+			
+			for (const auto& asset : assets) watcher.add(asset);
+			
+			continue;
+		}
+		
+		// Only search for new or deleted files if there are any
+		for (const auto& path : changes)
+		{
+			if (batch && (! jobs.count(path) || ! fs::exists(path)))
+			{
+				refresh();
+				
+				break;
+			}
+		}
+		
+		for (const auto& path : changes)
+		{
+			auto job = jobs.find(path);
+			
+			if (job != jobs.end() && fs::exists(path)) render(*job);
+		}
+	}
+}
+
+// The server to stop on SIGINT and SIGTERM
+Markdown::Server* server = nullptr;
+
+void stop_server(int)
+{
+	if (server) server->stop();
+}
+
+// Serves render requests on the socket until interrupted
+void serve(const std::string& socket,
+		   std::size_t workers,
+		   std::size_t timeout,
+		   const Markdown::Server::factory_t& factory)
+{
+	Markdown::Server daemon(socket, factory);
+	
+	daemon.configure("workers", workers);
+	
+	daemon.configure("timeout", timeout);
+	
+	server = &daemon;
+	
+	std::signal(SIGINT, stop_server);
+	
+	std::signal(SIGTERM, stop_server);
+	
+	std::signal(SIGPIPE, SIG_IGN);
+	
+	std::cout << "Serving on " << socket << std::endl;
+	
+	daemon.run();
+	
+	server = nullptr;
+	
+	std::cout << daemon.statistics().to_string();
+}
+
+// Renders the input through a server, returning false if none is listening.
+// Options in local_only (given, but not applicable per request) are errors.
+bool render_remotely(const std::string& socket,
+					 const std::string& input,
+					 const std::string& output,
+					 const Markdown::Configurable::settings_t& overrides,
+					 const std::vector<std::string>& local_only)
+{
+	std::unique_ptr<Markdown::Client> client;
+	
+	try
+	{
+		client = std::make_unique<Markdown::Client>(socket);
+	}
+	
+	catch (const Markdown::FileException&)
+	{
+		return false;
+	}
+	
+	if (! local_only.empty())
+	{
+		throw boost::program_options::error(
+			"the option '--" + local_only.front() + "' is the server's "
+			"(restart it with the option, or render without --socket)"
+		);
+	}
+	
+	std::string markdown;
+	
+	if (input == "-")
+	{
+		markdown.assign(std::istreambuf_iterator<char>(std::cin),
+						std::istreambuf_iterator<char>());
+	}
+	
+	else
+	{
+		Markdown::MappedFile file(input);
+		
+		markdown.assign(file.data(), file.size());
+	}
+	
+	auto html = client->render(markdown, overrides);
+	
+	if (output == "-") std::cout << html;
+	
+	else
+	{
+		std::ofstream file(output, std::ios::trunc);
+		
+		if (! file)
+		{
+			throw Markdown::FileException("Could not open file '" +
+										  output + "'!");
+		}
+		
+		file << html;
+	}
+	
+	return true;
+}
 
 int main(int argc, const char* argv[])
 {
@@ -14,10 +369,20 @@ int main(int argc, const char* argv[])
 	std::string markdown_style;
 	std::string code_style;
 	std::string include_mode;
+	std::string highlight_mode;
 	std::string stylesheet;
 	std::string root;
 	std::string input;
 	std::string output;
+	std::size_t jobs;
+	std::size_t math_threads;
+	std::size_t timeout;
+	std::string math_cache;
+	std::string math_engine;
+	std::string math_macros;
+	std::string manifest;
+	bool watching;
+	std::string socket;
 
 	description.add_options()
 		("help", "show help")
@@ -42,6 +407,13 @@ int main(int argc, const char* argv[])
 				->value_name("MODE"),
 			"set the include-mode"
 		)
+		(
+			"highlight-mode",
+			po::value<std::string>(&highlight_mode)
+				->default_value("client")
+				->value_name("MODE"),
+			"highlight code in the browser (client) or when rendering (server)"
+		)
 		(
 			"stylesheet,s",
 			po::value<std::string>(&stylesheet)
@@ -55,17 +427,86 @@ int main(int argc, const char* argv[])
 				->value_name("PATH"),
 			"set the root path"
 		)
+		(
+			"jobs,j",
+			po::value<std::size_t>(&jobs)
+				->default_value(0)
+				->value_name("N"),
+			"render directories/globs with N threads (0 = all cores)"
+		)
+		(
+			"math-threads,t",
+			po::value<std::size_t>(&math_threads)
+				->default_value(1)
+				->value_name("N"),
+			"render each document's equations with N threads (0 = all cores)"
+		)
+		(
+			"math-engine",
+			po::value<std::string>(&math_engine)
+				->default_value("katex")
+				->value_name("ENGINE"),
+			"render equations with KaTeX (katex), as MathML, falling back "
+			"to KaTeX for unsupported ones (native), or with KaTeX on "
+			"QuickJS (quickjs, if built with QUICKJS=1)"
+		)
+		(
+			"math-macros",
+			po::value<std::string>(&math_macros)
+				->value_name("PATH"),
+			"expand the LaTeX macros defined in PATH (\\newcommand or \\def) "
+			"in all equations"
+		)
+		(
+			"math-cache",
+			po::value<std::string>(&math_cache)
+				->value_name("DIR"),
+			"also keep rendered equations in DIR, across runs"
+		)
+		(
+			"manifest",
+			po::value<std::string>(&manifest)
+				->value_name("PATH"),
+			"skip unchanged files of a directory/glob, tracked in PATH"
+		)
+		(
+			"watch,w",
+			po::bool_switch(&watching),
+			"re-render whenever the input(s) or stylesheets change"
+		)
+		(
+			"socket",
+			po::value<std::string>(&socket)
+				->value_name("PATH"),
+			"render through the server on PATH [$MARKDOWNPP_SOCKET]; "
+			"with the input 'serve', run that server (using --jobs "
+			"workers); with 'statistics', show its latencies"
+		)
+		(
+			"timeout",
+			po::value<std::size_t>(&timeout)
+				->default_value(0)
+				->value_name("MS"),
+			"with 'serve', give each render MS milliseconds (0 = no limit); "
+			"equations not rendered by then are shown as errors"
+		)
+		(
+			"make-snapshot",
+			po::bool_switch(),
+			"create the V8 startup snapshot of KaTeX (in the root's "
+			"katex folder) and exit"
+		)
 		(
 			"input,i",
 			po::value<std::string>(&input)
 				->required(),
-			"the input markdown file"
+			"the input markdown file (- for stdin), directory or glob"
 		)
 		(
 			"output,o",
-			po::value<std::string>(&output)
-				->default_value("output.html"),
-			"the output html file"
+			po::value<std::string>(&output),
+			"the output html file [output.html] (- for stdout) or "
+			"directory [next to the input]"
 		);
 	
 	
@@ -91,20 +532,289 @@ int main(int argc, const char* argv[])
 			
 			return EXIT_SUCCESS;
 		} 
+		
+		// Needs no input, which po::notify() would insist on
+		if (variables["make-snapshot"].as<bool>())
+		{
+			auto katex = fs::path(variables["root"].as<std::string>()) / "katex";
+			
+			Markdown::Snapshot::create(katex.string());
+			
+			std::cout << "Created " << (katex / Markdown::Snapshot::file_name)
+					  << "\n";
+			
+			return EXIT_SUCCESS;
+		}
 
 		po::notify(variables);
 		
-		Markdown::Parser parser(root, stylesheet);
-	
-		parser.configure("include-mode", include_mode);
-	
-		parser.configure("markdown-style", markdown_style);
+		Markdown::MathCache::shared().directory(math_cache);
+		
+		std::string macros;
+		
+		if (! math_macros.empty())
+		{
+			Markdown::MappedFile file(math_macros);
+			
+			macros.assign(file.data(), file.trimmed_size());
+		}
+		
+		auto make_parser = [&] {
+			auto katex = (fs::path(root) / "katex").string();
+			
+			// The KaTeX engine (of each worker of a pool)
+			Markdown::MathPool::factory_t engine = [katex] {
+				std::unique_ptr<Markdown::AbstractMath> math =
+					std::make_unique<Markdown::Math>(katex);
+				
+				return math;
+			};
+			
+			auto settings = Markdown::Math::default_settings;
+			
+			bool javascript = math_engine == "katex";
+			
+#ifdef MARKDOWNPP_QUICKJS
+			if (math_engine == "quickjs")
+			{
+				engine = [katex] {
+					std::unique_ptr<Markdown::AbstractMath> math =
+						std::make_unique<Markdown::QuickJSMath>(katex);
+					
+					return math;
+				};
+				
+				settings = Markdown::QuickJSMath::default_settings;
+				
+				javascript = true;
+			}
+#endif
+			
+			// Only once there is math to render (that is not cached)
+			auto factory = [engine, settings, math_threads] {
+				std::unique_ptr<Markdown::AbstractMath> math;
+				
+				if (math_threads != 1)
+				{
+					math = std::make_unique<Markdown::MathPool>(engine,
+																math_threads,
+																settings);
+				}
+				
+				else math = engine();
+				
+				return math;
+			};
+			
+			std::unique_ptr<Markdown::CachedMath> math;
+			
+			if (math_engine == "native")
+			{
+				// KaTeX renders only the equations MathML cannot
+				math = std::make_unique<Markdown::CachedMath>(
+					std::make_unique<Markdown::NativeMath>(
+						factory,
+						Markdown::Snapshot::katex_hash(katex)
+					)
+				);
+			}
+			
+			else if (javascript)
+			{
+				math = std::make_unique<Markdown::CachedMath>(
+					factory,
+					settings,
+					Markdown::Snapshot::katex_hash(katex)
+				);
+			}
+			
+			else
+			{
+				throw Markdown::ConfigurationValueException("math-engine",
+															math_engine);
+			}
+			
+			// Equations recur within and across documents
+			auto parser = std::make_unique<Markdown::Parser>(
+				std::make_unique<Markdown::Markdown>(),
+				std::move(math),
+				root,
+				stylesheet
+			);
+			
+			parser->configure("include-mode", include_mode);
+			
+			parser->configure("markdown-style", markdown_style);
+			
+			parser->configure("code-style", code_style);
+			
+			parser->configure("highlight-mode", highlight_mode);
+			
+			parser->configure("math-engine", math_engine);
+			
+			parser->configure("math-macros", macros);
+			
+			return parser;
+		};
+		
+		if (socket.empty() && std::getenv("MARKDOWNPP_SOCKET"))
+		{
+			socket = std::getenv("MARKDOWNPP_SOCKET");
+		}
+		
+		if (input == "serve" || input == "statistics")
+		{
+			if (socket.empty())
+			{
+				throw po::error("the option '--socket' is required for '" +
+								input + "'");
+			}
+			
+			if (input == "serve") serve(socket, jobs, timeout, make_parser);
+			
+			else std::cout << Markdown::Client(socket).statistics();
+			
+			return EXIT_SUCCESS;
+		}
+		
+		if (watching)
+		{
+			if (input == "-" || output == "-")
+			{
+				throw Markdown::FileException("Cannot watch standard streams!");
+			}
+			
+			if (output.empty() && ! is_batch(input)) output = "output.html";
+			
+			watch(*make_parser(), input, output);
+		}
+		
+		if (is_batch(input))
+		{
+			Markdown::BatchRenderer renderer(make_parser);
+			
+			renderer.configure("jobs", jobs);
+			
+			renderer.manifest(manifest);
+			
+			renderer.output_root(output.empty() ? base_of(input).string() : output);
+			
+			for (const auto& job : collect(input, output))
+			{
+				renderer.add(job.first, job.second);
+			}
+			
+			std::size_t failures = 0;
+			
+			std::size_t skipped = 0;
+			
+			for (const auto& result : renderer.run())
+			{
+				if (! result.success)
+				{
+					std::cerr << "\033[91mError\033[0m: " << result.error << "\n";
+					
+					++failures;
+				}
+				
+				else if (result.skipped) ++skipped;
+			}
+			
+			if (manifest.empty())
+			{
+				std::cout << "Rendered " << (renderer.size() - failures)
+						  << " of " << renderer.size() << " files\n";
+			}
+			
+			else
+			{
+				std::cout << "Rebuilt " << (renderer.size() - failures - skipped)
+						  << ", skipped " << skipped
+						  << ", deleted " << renderer.deleted().size();
+				
+				if (failures) std::cout << ", failed " << failures;
+				
+				std::cout << "\n";
+			}
+			
+			return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+		}
+		
+		if (output.empty()) output = "output.html";
+		
+		Markdown::Configurable::settings_t overrides = {
+			{"include-mode", include_mode},
+			{"markdown-style", markdown_style},
+			{"code-style", code_style},
+			{"highlight-mode", highlight_mode}
+		};
+		
+		// Otherwise the server's macros apply
+		if (! macros.empty()) overrides.emplace("math-macros", macros);
+		
+		// The server's math engine is fixed when it starts
+		std::vector<std::string> local_only;
+		
+		for (const auto& option : {"math-engine", "math-threads", "math-cache"})
+		{
+			if (variables.count(option) && ! variables[option].defaulted())
+			{
+				local_only.emplace_back(option);
+			}
+		}
+		
+		// Falls back to rendering locally if no server is running
+		if (! socket.empty() &&
+			render_remotely(socket, input, output, overrides, local_only))
+		{
+			if (output != "-")
+			{
+				std::cout << "Success \033[91m<3\033[0m\n";
+			}
+			
+			return EXIT_SUCCESS;
+		}
 		
-		parser.configure("code-style", code_style);
+		auto parser_pointer = make_parser();
 		
-		parser.render_file(input, output);
+		auto& parser = *parser_pointer;
 		
-		std::cout << "Success \033[91m<3\033[0m\n";
+		// Only standard input is streamed (in chunks), files are rendered whole
+		if (input == "-")
+		{
+			std::ios::sync_with_stdio(false);
+			
+			std::ofstream output_file;
+			
+			if (output != "-")
+			{
+				output_file.open(output, std::ios::trunc);
+				
+				if (! output_file)
+				{
+					throw Markdown::FileException("Could not open file '" +
+												  output + "'!");
+				}
+			}
+			
+			std::ostream& out = (output == "-") ? std::cout : output_file;
+			
+			parser.render(std::cin, out);
+		}
+		
+		else if (output == "-")
+		{
+			std::ios::sync_with_stdio(false);
+			
+			std::cout << parser.render_file(input) << std::flush;
+		}
+		
+		else parser.render_file(input, output);
+		
+		if (output != "-")
+		{
+			std::cout << "Success \033[91m<3\033[0m\n";
+		}
 	}
 	
 	catch(po::error& error)
@@ -115,5 +825,12 @@ int main(int argc, const char* argv[])
 		return EXIT_FAILURE;
 	}
 	
+	catch(std::exception& error)
+	{
+		std::cerr << "\033[91mError\033[0m: " << error.what() << "\n";
+		
+		return EXIT_FAILURE;
+	}
+	
 	return EXIT_SUCCESS;
 }
@@ -5,4 +5,10 @@ namespace Markdown
 	AbstractMarkdown::AbstractMarkdown(const Configurable::settings_t& settings)
 	: Configurable(settings)
 	{ }
+	
+	std::string AbstractMarkdown::render(const char* markdown,
+										 std::size_t size)
+	{
+		return render(std::string(markdown, size));
+	}
 }
\ No newline at end of file
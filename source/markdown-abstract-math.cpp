@@ -5,4 +5,37 @@ namespace Markdown
 	AbstractMath::AbstractMath(const Configurable::settings_t& settings)
 	: Configurable(settings)
 	{ }
+	
+	std::vector<std::string>
+	AbstractMath::render(const std::vector<expression_t>& expressions)
+	{
+		std::vector<std::string> html;
+		
+		html.reserve(expressions.size());
+		
+		for (const auto& expression : expressions)
+		{
+			html.push_back(render(expression.first, expression.second));
+		}
+		
+		return html;
+	}
+	
+	std::string AbstractMath::fingerprint() const
+	{
+		return "";
+	}
+	
+	void AbstractMath::idle()
+	{ }
+	
+	void AbstractMath::deadline(const Deadline& deadline)
+	{
+		_deadline = deadline;
+	}
+	
+	const Deadline& AbstractMath::deadline() const
+	{
+		return _deadline;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "markdown-asset-cache.hpp"
+
+#include <boost/filesystem.hpp>
+#include <sys/stat.h>
+
+namespace Markdown
+{
+	AssetCache& AssetCache::shared()
+	{
+		static AssetCache cache;
+
+		return cache;
+	}
+
+	AssetCache::AssetCache()
+	: _hits(0)
+	, _misses(0)
+	{ }
+
+	std::string AssetCache::get(const std::string& path,
+								const std::string& kind,
+								const loader_t& loader)
+	{
+		Stamp stamp;
+
+		if (! _stamp(path, stamp))
+		{
+			++_misses;
+
+			return loader(path);
+		}
+
+		auto key = _key(path, kind);
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			auto entry = _entries.find(key);
+
+			if (entry != _entries.end() && entry->second.stamp == stamp)
+			{
+				++_hits;
+
+				return entry->second.contents;
+			}
+		}
+
+		++_misses;
+
+		// Load outside the lock, a concurrent miss just loads twice
+		auto contents = loader(path);
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_entries[key] = {stamp, contents};
+
+		return contents;
+	}
+
+	bool AssetCache::modified(const std::string& path,
+							  const std::string& kind) const
+	{
+		Stamp stamp;
+
+		if (! _stamp(path, stamp)) return true;
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		auto entry = _entries.find(_key(path, kind));
+
+		return entry == _entries.end() || ! (entry->second.stamp == stamp);
+	}
+
+	void AssetCache::clear()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_entries.clear();
+	}
+
+	std::size_t AssetCache::size() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		return _entries.size();
+	}
+
+	std::size_t AssetCache::hits() const noexcept
+	{
+		return _hits;
+	}
+
+	std::size_t AssetCache::misses() const noexcept
+	{
+		return _misses;
+	}
+
+	bool AssetCache::Stamp::operator==(const Stamp& other) const noexcept
+	{
+		return device == other.device &&
+			   inode == other.inode &&
+			   size == other.size &&
+			   modified == other.modified &&
+			   modified_nanoseconds == other.modified_nanoseconds;
+	}
+
+	bool AssetCache::_stamp(const std::string& path, Stamp& stamp)
+	{
+		struct stat status;
+
+		if (::stat(path.c_str(), &status) != 0) return false;
+
+		stamp.device = status.st_dev;
+
+		stamp.inode = status.st_ino;
+
+		stamp.size = status.st_size;
+
+		stamp.modified = status.st_mtime;
+
+		// Catches writes within the same second
+#if defined(__APPLE__)
+		stamp.modified_nanoseconds = status.st_mtimespec.tv_nsec;
+#elif defined(st_mtime)
+		// POSIX.1-2008, where st_mtime is st_mtim.tv_sec
+		stamp.modified_nanoseconds = status.st_mtim.tv_nsec;
+#else
+		stamp.modified_nanoseconds = 0;
+#endif
+
+		return true;
+	}
+
+	std::string AssetCache::_key(const std::string& path,
+								 const std::string& kind)
+	{
+		return kind + '\0' + boost::filesystem::absolute(path).string();
+	}
+}
@@ -0,0 +1,383 @@
+#include "markdown-batch-renderer.hpp"
+#include "markdown-hash.hpp"
+#include "markdown-mapped-file.hpp"
+#include "markdown-parser.hpp"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <exception>
+#include <thread>
+
+namespace Markdown
+{
+	const Configurable::settings_t BatchRenderer::default_settings = {
+		{"jobs", "0"},
+		{"memory-limit", "268435456"}
+	};
+
+	BatchRenderer::BatchRenderer(const factory_t& factory,
+								 const Configurable::settings_t& settings)
+	: Configurable(settings)
+	, _factory(factory)
+	, _memory_in_use(0)
+	, _memory_limit(0)
+	{ }
+
+	void BatchRenderer::add(const std::string& input, const std::string& output)
+	{
+		_jobs.emplace_back(input, output);
+	}
+
+	void BatchRenderer::clear()
+	{
+		_jobs.clear();
+	}
+
+	std::size_t BatchRenderer::size() const
+	{
+		return _jobs.size();
+	}
+
+	void BatchRenderer::manifest(const std::string& path)
+	{
+		_manifest_path = path;
+	}
+
+	const std::string& BatchRenderer::manifest() const
+	{
+		return _manifest_path;
+	}
+
+	void BatchRenderer::output_root(const std::string& path)
+	{
+		_output_root = path;
+	}
+
+	const std::string& BatchRenderer::output_root() const
+	{
+		return _output_root;
+	}
+
+	const std::vector<std::string>& BatchRenderer::deleted() const
+	{
+		return _deleted;
+	}
+
+	BatchRenderer::results_t BatchRenderer::run()
+	{
+		results_t results(_jobs.size());
+
+		_deleted.clear();
+
+		_entries.assign(_jobs.size(), Manifest::Entry());
+
+		if (! _manifest_path.empty())
+		{
+			_manifest = std::make_unique<Manifest>(_manifest_path);
+
+			_delete_orphans();
+		}
+
+		std::vector<Job> jobs;
+
+		for (std::size_t index = 0; index < _jobs.size(); ++index)
+		{
+			results[index] = {
+				_jobs[index].first,
+				_jobs[index].second,
+				false,
+				false,
+				""
+			};
+
+			boost::system::error_code error;
+
+			auto size = boost::filesystem::file_size(_jobs[index].first, error);
+
+			jobs.push_back({index, error ? 0 : static_cast<std::size_t>(size)});
+		}
+
+		auto workers = Configurable::get<std::size_t>("jobs");
+
+		if (workers == 0)
+		{
+			workers = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		workers = std::max(std::min(workers, jobs.size()), std::size_t(1));
+
+		_memory_limit = Configurable::get<std::size_t>("memory-limit");
+
+		_memory_in_use = 0;
+
+		// Largest jobs first, dealt out round-robin
+		std::sort(jobs.begin(), jobs.end(), [] (const Job& first,
+												const Job& second) {
+			return first.size > second.size;
+		});
+
+		_queues.clear();
+
+		for (std::size_t worker = 0; worker < workers; ++worker)
+		{
+			_queues.push_back(std::make_unique<Queue>());
+		}
+
+		for (std::size_t i = 0; i < jobs.size(); ++i)
+		{
+			_queues[i % workers]->jobs.push_back(jobs[i]);
+		}
+
+		std::vector<std::thread> threads;
+
+		for (std::size_t worker = 0; worker < workers; ++worker)
+		{
+			threads.emplace_back(&BatchRenderer::_work,
+								 this,
+								 worker,
+								 std::ref(results));
+		}
+
+		for (auto& thread : threads) thread.join();
+
+		_queues.clear();
+
+		if (_manifest)
+		{
+			for (std::size_t index = 0; index < results.size(); ++index)
+			{
+				if (results[index].success)
+				{
+					_manifest->update(results[index].output, _entries[index]);
+				}
+
+				// Make sure failed outputs are rebuilt next time
+				else _manifest->erase(results[index].output);
+			}
+
+			_manifest->save();
+
+			_manifest.reset();
+		}
+
+		return results;
+	}
+
+	void BatchRenderer::_work(std::size_t worker, results_t& results)
+	{
+		std::unique_ptr<Parser> parser;
+
+		try
+		{
+			parser = _factory();
+		}
+
+		catch (const std::exception& exception)
+		{
+			// Without a parser this worker can only fail its jobs
+			Job job;
+
+			while (_next(worker, job))
+			{
+				results[job.index].error = exception.what();
+			}
+
+			return;
+		}
+
+		std::string settings_hash;
+
+		try
+		{
+			if (_manifest) settings_hash = parser->fingerprint();
+		}
+
+		catch (const std::exception&)
+		{
+			// Without a fingerprint, everything is rebuilt
+		}
+
+		Job job;
+
+		while (_next(worker, job))
+		{
+			auto& result = results[job.index];
+
+			_acquire(job.size);
+
+			try
+			{
+				if (! settings_hash.empty())
+				{
+					MappedFile input(result.input);
+
+					auto& entry = _entries[job.index];
+
+					// Independent of the working directory
+					entry.input = boost::filesystem::canonical(result.input).string();
+
+					entry.input_hash = Hash().update(input.data(),
+													 input.size()).hex();
+
+					entry.settings_hash = settings_hash;
+
+					auto* previous = _manifest->find(result.output);
+
+					if (previous &&
+						previous->input == entry.input &&
+						previous->input_hash == entry.input_hash &&
+						previous->settings_hash == entry.settings_hash &&
+						boost::filesystem::exists(result.output))
+					{
+						result.success = result.skipped = true;
+
+						_release(job.size);
+
+						continue;
+					}
+				}
+
+				auto directory = boost::filesystem::path(result.output)
+									 .parent_path();
+
+				if (! directory.empty())
+				{
+					boost::filesystem::create_directories(directory);
+				}
+
+				parser->render_file(result.input, result.output);
+
+				result.success = true;
+			}
+
+			catch (const std::exception& exception)
+			{
+				result.error = exception.what();
+			}
+
+			_release(job.size);
+		}
+	}
+
+	bool BatchRenderer::_next(std::size_t worker, Job& job)
+	{
+		{
+			auto& own = *_queues[worker];
+
+			std::lock_guard<std::mutex> lock(own.mutex);
+
+			if (! own.jobs.empty())
+			{
+				job = own.jobs.front();
+
+				own.jobs.pop_front();
+
+				return true;
+			}
+		}
+
+		// Steal from the other workers, starting with the next one
+		for (std::size_t offset = 1; offset < _queues.size(); ++offset)
+		{
+			auto& victim = *_queues[(worker + offset) % _queues.size()];
+
+			std::lock_guard<std::mutex> lock(victim.mutex);
+
+			if (! victim.jobs.empty())
+			{
+				job = victim.jobs.back();
+
+				victim.jobs.pop_back();
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void BatchRenderer::_acquire(std::size_t bytes)
+	{
+		std::unique_lock<std::mutex> lock(_memory_mutex);
+
+		_memory_released.wait(lock, [this, bytes] {
+			return _memory_in_use == 0 ||
+				   _memory_in_use + bytes <= _memory_limit;
+		});
+
+		_memory_in_use += bytes;
+	}
+
+	void BatchRenderer::_delete_orphans()
+	{
+		boost::system::error_code error;
+
+		boost::filesystem::path root;
+
+		if (! _output_root.empty())
+		{
+			root = boost::filesystem::canonical(_output_root, error);
+		}
+
+		if (error) root.clear();
+
+		// Whether an (existing) output lies inside the output root
+		auto inside_root = [&] (const std::string& output) {
+			boost::system::error_code error;
+
+			auto path = boost::filesystem::canonical(output, error);
+
+			if (error || root.empty()) return false;
+
+			auto component = path.begin();
+
+			for (const auto& directory : root)
+			{
+				if (component == path.end() || *component != directory)
+				{
+					return false;
+				}
+
+				++component;
+			}
+
+			return true;
+		};
+
+		std::vector<std::string> orphans;
+
+		for (const auto& entry : _manifest->entries())
+		{
+			if (! boost::filesystem::path(entry.second.input).is_absolute() ||
+				! boost::filesystem::exists(entry.second.input))
+			{
+				orphans.push_back(entry.first);
+			}
+		}
+
+		for (const auto& output : orphans)
+		{
+			auto input = _manifest->find(output)->input;
+
+			if (boost::filesystem::path(input).is_absolute() && inside_root(output))
+			{
+				boost::filesystem::remove(output, error);
+
+				_deleted.push_back(output);
+			}
+
+			_manifest->erase(output);
+		}
+	}
+
+	void BatchRenderer::_release(std::size_t bytes)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_memory_mutex);
+
+			_memory_in_use -= bytes;
+		}
+
+		_memory_released.notify_all();
+	}
+}
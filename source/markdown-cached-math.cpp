@@ -0,0 +1,179 @@
+#include "markdown-cached-math.hpp"
+#include "markdown-hash.hpp"
+
+#include <cctype>
+#include <map>
+#include <unordered_map>
+
+namespace Markdown
+{
+	CachedMath::CachedMath(std::unique_ptr<AbstractMath> engine,
+						   MathCache& cache)
+	: AbstractMath(engine->settings())
+	, _engine(std::move(engine))
+	, _cache(cache)
+	{ }
+
+	CachedMath::CachedMath(const factory_t& factory,
+						   const Configurable::settings_t& settings,
+						   const std::string& fingerprint,
+						   MathCache& cache)
+	: AbstractMath(settings)
+	, _factory(factory)
+	, _fingerprint(fingerprint)
+	, _cache(cache)
+	{ }
+
+	std::string CachedMath::render(const std::string& expression,
+								   bool display_math)
+	{
+		std::vector<expression_t> expressions = {{expression, display_math}};
+
+		return render(expressions).front();
+	}
+
+	std::vector<std::string>
+	CachedMath::render(const std::vector<expression_t>& expressions)
+	{
+		// Everything but the expression itself that determines the HTML
+		Hash context;
+
+		for (const auto& setting : std::map<std::string, std::string>(
+				 Configurable::settings().begin(),
+				 Configurable::settings().end()))
+		{
+			context.update(setting.first).update(setting.second);
+		}
+
+		context.update(fingerprint());
+
+		std::vector<std::string> results(expressions.size());
+
+		std::vector<std::string> keys(expressions.size());
+
+		std::vector<expression_t> misses;
+
+		// The expressions waiting for each miss
+		std::vector<std::vector<std::size_t>> waiting;
+
+		std::unordered_map<std::string, std::size_t> pending;
+
+		for (std::size_t index = 0; index < expressions.size(); ++index)
+		{
+			const auto& expression = expressions[index];
+
+			auto normalized = _normalize(expression.first);
+
+			keys[index] = Hash(context).update(normalized)
+									   .update(expression.second ? "1" : "0")
+									   .hex();
+
+			auto miss = pending.find(keys[index]);
+
+			if (miss != pending.end())
+			{
+				waiting[miss->second].push_back(index);
+			}
+
+			else if (! _cache.find(keys[index], results[index]))
+			{
+				pending.emplace(keys[index], misses.size());
+
+				misses.push_back(expression);
+
+				waiting.push_back({index});
+			}
+		}
+
+		if (misses.empty()) return results;
+
+		auto& engine = this->engine();
+
+		engine.settings(Configurable::settings());
+
+		engine.deadline(_deadline);
+
+		auto rendered = engine.render(misses);
+
+		// Expressions cut short by the deadline are rendered as errors
+		auto complete = ! _deadline.expired();
+
+		for (std::size_t miss = 0; miss < misses.size(); ++miss)
+		{
+			if (complete) _cache.insert(keys[waiting[miss].front()], rendered[miss]);
+
+			for (auto index : waiting[miss])
+			{
+				results[index] = rendered[miss];
+			}
+		}
+
+		return results;
+	}
+
+	std::string CachedMath::fingerprint() const
+	{
+		// Known up front for lazily created engines
+		return _factory ? _fingerprint : _engine->fingerprint();
+	}
+
+	void CachedMath::idle()
+	{
+		if (_engine) _engine->idle();
+	}
+
+	AbstractMath& CachedMath::engine()
+	{
+		return *_create();
+	}
+
+	MathCache& CachedMath::cache()
+	{
+		return _cache;
+	}
+
+	AbstractMath* CachedMath::_create() const
+	{
+		if (! _engine) _engine = _factory();
+
+		return _engine.get();
+	}
+
+	std::string CachedMath::_normalize(const std::string& expression)
+	{
+		// A comment runs until the end of the line, so newlines matter
+		if (expression.find('%') != std::string::npos) return expression;
+
+		std::string normalized;
+
+		normalized.reserve(expression.size());
+
+		bool space = false;
+
+		for (auto character : expression)
+		{
+			if (std::isspace(static_cast<unsigned char>(character)))
+			{
+				space = true;
+			}
+
+			else
+			{
+				// Leading whitespace is dropped
+				if (space && ! normalized.empty()) normalized += ' ';
+
+				normalized += character;
+
+				space = false;
+			}
+		}
+
+		// "\ " is a (significant) control space
+		if (space && ! normalized.empty() && normalized.back() == '\\')
+		{
+			normalized += ' ';
+		}
+
+		return normalized;
+	}
+}
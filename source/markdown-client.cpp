@@ -0,0 +1,50 @@
+#include "markdown-client.hpp"
+#include "markdown-exceptions.hpp"
+
+namespace Markdown
+{
+	Client::Client(const std::string& path)
+	: _connection(Connection::connect(path))
+	{ }
+
+	std::string Client::render(const std::string& markdown,
+							   const Configurable::settings_t& overrides)
+	{
+		Connection::message_t request = {"render", markdown};
+
+		for (const auto& setting : overrides)
+		{
+			request.push_back(setting.first);
+
+			request.push_back(setting.second);
+		}
+
+		return _request(request);
+	}
+
+	std::string Client::statistics()
+	{
+		return _request({"statistics"});
+	}
+
+	std::string Client::_request(const Connection::message_t& request)
+	{
+		_connection.send(request);
+
+		Connection::message_t response;
+
+		if (! _connection.receive(response))
+		{
+			throw FileException("The server closed the connection!");
+		}
+
+		if (response.size() != 2)
+		{
+			throw ServerException("Received a malformed response!");
+		}
+
+		if (response.front() != "ok") throw ServerException(response.back());
+
+		return response.back();
+	}
+}
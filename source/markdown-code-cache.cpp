@@ -0,0 +1,223 @@
+#include "markdown-code-cache.hpp"
+#include "markdown-exceptions.hpp"
+#include "markdown-hash.hpp"
+#include "markdown-mapped-file.hpp"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+namespace Markdown
+{
+	CodeCache& CodeCache::shared()
+	{
+		static CodeCache cache;
+
+		return cache;
+	}
+
+	CodeCache::CodeCache()
+	: _accepted(0)
+	, _rejected(0)
+	, _produced(0)
+	{ }
+
+	v8::Local<v8::Script> CodeCache::compile(const v8::Local<v8::Context>& context,
+											 const std::string& path,
+											 const std::string& source,
+											 const std::string& directory)
+	{
+		auto isolate = context->GetIsolate();
+
+		auto string = v8::String::NewFromUtf8(isolate,
+											  source.data(),
+											  v8::NewStringType::kNormal,
+											  static_cast<int>(source.size()));
+
+		auto header = _header(source);
+
+		auto file = _file(path, directory);
+
+		std::string data;
+
+		v8::Local<v8::Script> script;
+
+		if (_find(file, header, data))
+		{
+			// The Source deletes the CachedData, but not the buffer
+			auto cached = new v8::ScriptCompiler::CachedData(
+				reinterpret_cast<const std::uint8_t*>(data.data()),
+				static_cast<int>(data.size()));
+
+			v8::ScriptCompiler::Source consumer(string.ToLocalChecked(), cached);
+
+			auto compiled = v8::ScriptCompiler::Compile(
+				context,
+				&consumer,
+				v8::ScriptCompiler::kConsumeCodeCache);
+
+			if (compiled.ToLocal(&script) && ! consumer.GetCachedData()->rejected)
+			{
+				++_accepted;
+
+				return script;
+			}
+
+			++_rejected;
+		}
+
+		v8::ScriptCompiler::Source producer(string.ToLocalChecked());
+
+		auto compiled = v8::ScriptCompiler::Compile(
+			context,
+			&producer,
+			v8::ScriptCompiler::kProduceCodeCache);
+
+		if (! compiled.ToLocal(&script))
+		{
+			throw ParseException("Could not compile '" + path + "'!");
+		}
+
+		auto produced = producer.GetCachedData();
+
+		if (produced && produced->length > 0)
+		{
+			_store(file,
+				   header,
+				   {reinterpret_cast<const char*>(produced->data),
+					static_cast<std::size_t>(produced->length)});
+
+			++_produced;
+		}
+
+		return script;
+	}
+
+	void CodeCache::clear()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_entries.clear();
+	}
+
+	std::size_t CodeCache::accepted() const noexcept
+	{
+		return _accepted;
+	}
+
+	std::size_t CodeCache::rejected() const noexcept
+	{
+		return _rejected;
+	}
+
+	std::size_t CodeCache::produced() const noexcept
+	{
+		return _produced;
+	}
+
+	std::string CodeCache::_header(const std::string& source)
+	{
+		std::string header = "markdownpp-code-cache\n";
+
+		header += v8::V8::GetVersion();
+
+		header += "\n" + Hash().update(source).hex() + "\n";
+
+		return header;
+	}
+
+	std::string CodeCache::_file(const std::string& path,
+								 const std::string& directory)
+	{
+		if (directory.empty()) return path + ".cache";
+
+		auto name = boost::filesystem::path(path).filename().string();
+
+		return (boost::filesystem::path(directory) / (name + ".cache")).string();
+	}
+
+	bool CodeCache::_find(const std::string& file,
+						  const std::string& header,
+						  std::string& data)
+	{
+		auto starts_with_header = [&header] (const char* contents,
+											 std::size_t size) {
+			return size > header.size() &&
+				   std::equal(header.begin(), header.end(), contents);
+		};
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			auto entry = _entries.find(file);
+
+			if (entry != _entries.end() &&
+				starts_with_header(entry->second.data(), entry->second.size()))
+			{
+				data = entry->second.substr(header.size());
+
+				return true;
+			}
+		}
+
+		if (! boost::filesystem::exists(file)) return false;
+
+		try
+		{
+			MappedFile contents(file);
+
+			if (! starts_with_header(contents.data(), contents.size()))
+			{
+				return false;
+			}
+
+			data.assign(contents.data() + header.size(),
+						contents.size() - header.size());
+		}
+
+		catch (const FileException&)
+		{
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_entries[file] = header + data;
+
+		return true;
+	}
+
+	void CodeCache::_store(const std::string& file,
+						   const std::string& header,
+						   std::string data)
+	{
+		data.insert(0, header);
+
+		// Other threads (or processes) may be storing the same file
+		std::ostringstream temporary;
+
+		temporary << file << "." << ::getpid() << "."
+				  << std::this_thread::get_id() << ".tmp";
+
+		std::ofstream stream(temporary.str(), std::ios::binary | std::ios::trunc);
+
+		stream.write(data.data(), data.size());
+
+		stream.close();
+
+		if (! stream || std::rename(temporary.str().c_str(), file.c_str()) != 0)
+		{
+			std::remove(temporary.str().c_str());
+		}
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_entries[file] = std::move(data);
+	}
+}
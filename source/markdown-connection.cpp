@@ -0,0 +1,207 @@
+#include "markdown-connection.hpp"
+#include "markdown-exceptions.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace Markdown
+{
+	namespace
+	{
+		void put(std::string& buffer, std::uint32_t value)
+		{
+			char bytes[4] = {
+				static_cast<char>(value >> 24),
+				static_cast<char>(value >> 16),
+				static_cast<char>(value >> 8),
+				static_cast<char>(value)
+			};
+
+			buffer.append(bytes, 4);
+		}
+
+		std::uint32_t get(const char* bytes)
+		{
+			auto data = reinterpret_cast<const unsigned char*>(bytes);
+
+			return (std::uint32_t(data[0]) << 24) |
+				   (std::uint32_t(data[1]) << 16) |
+				   (std::uint32_t(data[2]) << 8)  |
+				   std::uint32_t(data[3]);
+		}
+	}
+
+	const std::size_t Connection::maximum_size = std::size_t(1) << 30;
+
+	Connection Connection::connect(const std::string& path)
+	{
+		sockaddr_un address;
+
+		if (path.size() >= sizeof(address.sun_path))
+		{
+			throw FileException("Socket path '" + path + "' is too long!");
+		}
+
+		std::memset(&address, 0, sizeof(address));
+
+		address.sun_family = AF_UNIX;
+
+		std::strcpy(address.sun_path, path.c_str());
+
+		Connection connection(::socket(AF_UNIX, SOCK_STREAM, 0));
+
+		if (connection._descriptor < 0 ||
+			::connect(connection._descriptor,
+					  reinterpret_cast<sockaddr*>(&address),
+					  sizeof(address)) != 0)
+		{
+			throw FileException("Could not connect to '" + path + "'!");
+		}
+
+		return connection;
+	}
+
+	Connection::Connection(int descriptor) noexcept
+	: _descriptor(descriptor)
+	{ }
+
+	Connection::Connection(Connection&& other) noexcept
+	: _descriptor(other._descriptor)
+	{
+		other._descriptor = -1;
+	}
+
+	Connection& Connection::operator=(Connection&& other) noexcept
+	{
+		std::swap(_descriptor, other._descriptor);
+
+		return *this;
+	}
+
+	Connection::~Connection()
+	{
+		if (_descriptor >= 0) ::close(_descriptor);
+	}
+
+	void Connection::send(const message_t& message)
+	{
+		std::size_t size = 0;
+
+		for (const auto& part : message) size += 4 + part.size();
+
+		if (size > maximum_size)
+		{
+			throw FileException("Message exceeds the maximum size!");
+		}
+
+		std::string frame;
+
+		frame.reserve(4 + size);
+
+		put(frame, size);
+
+		for (const auto& part : message)
+		{
+			put(frame, part.size());
+
+			frame += part;
+		}
+
+		int flags = 0;
+
+#ifdef MSG_NOSIGNAL
+		flags = MSG_NOSIGNAL;
+#endif
+
+		for (std::size_t sent = 0; sent < frame.size(); )
+		{
+			auto count = ::send(_descriptor,
+								frame.data() + sent,
+								frame.size() - sent,
+								flags);
+
+			if (count < 0 && errno == EINTR) continue;
+
+			if (count <= 0) throw FileException("Could not send message!");
+
+			sent += count;
+		}
+	}
+
+	bool Connection::receive(message_t& message)
+	{
+		char header[4];
+
+		if (! _read(header, 4)) return false;
+
+		auto size = get(header);
+
+		if (size > maximum_size)
+		{
+			throw FileException("Message exceeds the maximum size!");
+		}
+
+		std::string frame(size, '\0');
+
+		if (size > 0 && ! _read(&frame[0], size))
+		{
+			throw FileException("Connection closed unexpectedly!");
+		}
+
+		message.clear();
+
+		for (std::size_t position = 0; position < size; )
+		{
+			if (size - position < 4)
+			{
+				throw FileException("Received a malformed message!");
+			}
+
+			auto length = get(&frame[position]);
+
+			position += 4;
+
+			if (length > size - position)
+			{
+				throw FileException("Received a malformed message!");
+			}
+
+			message.emplace_back(frame, position, length);
+
+			position += length;
+		}
+
+		return true;
+	}
+
+	int Connection::descriptor() const noexcept
+	{
+		return _descriptor;
+	}
+
+	bool Connection::_read(char* buffer, std::size_t size)
+	{
+		for (std::size_t total = 0; total < size; )
+		{
+			auto count = ::read(_descriptor, buffer + total, size - total);
+
+			if (count < 0 && errno == EINTR) continue;
+
+			if (count <= 0)
+			{
+				if (total == 0 && count == 0) return false;
+
+				throw FileException("Connection closed unexpectedly!");
+			}
+
+			total += count;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,67 @@
+#include "markdown-deadline.hpp"
+#include "markdown-exceptions.hpp"
+
+namespace Markdown
+{
+	Deadline::Deadline()
+	: _state(std::make_shared<State>())
+	{
+		_state->limited = false;
+
+		_state->cancellable = false;
+
+		_state->cancelled = false;
+	}
+
+	Deadline::Deadline(clock_t::duration timeout)
+	: Deadline()
+	{
+		_state->time = clock_t::now() + timeout;
+
+		_state->limited = true;
+	}
+
+	Deadline Deadline::cancellable()
+	{
+		Deadline deadline;
+
+		deadline._state->cancellable = true;
+
+		return deadline;
+	}
+
+	void Deadline::cancel() noexcept
+	{
+		_state->cancelled = true;
+	}
+
+	bool Deadline::expired() const noexcept
+	{
+		if (_state->cancelled) return true;
+
+		return _state->limited && clock_t::now() >= _state->time;
+	}
+
+	bool Deadline::limited() const noexcept
+	{
+		return _state->limited;
+	}
+
+	Deadline::clock_t::time_point Deadline::time() const noexcept
+	{
+		return _state->time;
+	}
+
+	bool Deadline::watched() const noexcept
+	{
+		return _state->limited || _state->cancellable;
+	}
+
+	void Deadline::check(const std::string& stage) const
+	{
+		if (expired())
+		{
+			throw TimeoutException("Deadline expired before " + stage + "!");
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#include "markdown-hash.hpp"
+
+namespace Markdown
+{
+	Hash::Hash() noexcept
+	: _state(0xcbf29ce484222325)
+	{ }
+
+	Hash& Hash::update(const char* data, std::size_t size) noexcept
+	{
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			_state ^= static_cast<unsigned char>(data[i]);
+
+			_state *= 0x100000001b3;
+		}
+
+		return *this;
+	}
+
+	Hash& Hash::update(const std::string& string)
+	{
+		auto size = std::to_string(string.size()) + ':';
+
+		update(size.data(), size.size());
+
+		return update(string.data(), string.size());
+	}
+
+	std::uint64_t Hash::digest() const noexcept
+	{
+		return _state;
+	}
+
+	std::string Hash::hex() const
+	{
+		static const char digits[] = "0123456789abcdef";
+
+		std::string result(16, '0');
+
+		auto state = _state;
+
+		for (auto i = result.rbegin(); i != result.rend(); ++i, state >>= 4)
+		{
+			*i = digits[state & 0xf];
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,104 @@
+#include "markdown-highlight-cache.hpp"
+
+namespace Markdown
+{
+	const std::size_t HighlightCache::default_capacity = 16 << 20;
+
+	HighlightCache::HighlightCache(std::size_t capacity)
+	: _capacity(capacity)
+	, _bytes(0)
+	{ }
+
+	bool HighlightCache::find(const std::string& key, std::string& html)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		auto entry = _index.find(key);
+
+		if (entry == _index.end()) return false;
+
+		// Move to the front (most recently used)
+		_entries.splice(_entries.begin(), _entries, entry->second);
+
+		html = entry->second->second;
+
+		return true;
+	}
+
+	void HighlightCache::insert(const std::string& key, const std::string& html)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		auto entry = _index.find(key);
+
+		if (entry != _index.end())
+		{
+			_bytes -= entry->second->second.size();
+
+			entry->second->second = html;
+
+			_entries.splice(_entries.begin(), _entries, entry->second);
+		}
+
+		else
+		{
+			_entries.emplace_front(key, html);
+
+			_index.emplace(key, _entries.begin());
+
+			_bytes += key.size();
+		}
+
+		_bytes += html.size();
+
+		_evict();
+	}
+
+	void HighlightCache::capacity(std::size_t capacity)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_capacity = capacity;
+
+		_evict();
+	}
+
+	std::size_t HighlightCache::capacity() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		return _capacity;
+	}
+
+	std::size_t HighlightCache::size() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		return _index.size();
+	}
+
+	void HighlightCache::clear()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_entries.clear();
+
+		_index.clear();
+
+		_bytes = 0;
+	}
+
+	void HighlightCache::_evict()
+	{
+		while (_bytes > _capacity && ! _entries.empty())
+		{
+			const auto& oldest = _entries.back();
+
+			_bytes -= oldest.first.size() + oldest.second.size();
+
+			_index.erase(oldest.first);
+
+			_entries.pop_back();
+		}
+	}
+}
@@ -0,0 +1,188 @@
+#include "markdown-highlighter.hpp"
+#include "markdown-code-cache.hpp"
+#include "markdown-exceptions.hpp"
+#include "markdown-hash.hpp"
+#include "markdown-mapped-file.hpp"
+#include "markdown-v8.hpp"
+
+#include <boost/filesystem.hpp>
+
+namespace Markdown
+{
+	const std::string Highlighter::_helper_source =
+		"(function (code, language) {"
+		"	var result = language && hljs.getLanguage(language) ?"
+		"		hljs.highlight(language, code, true) :"
+		"		hljs.highlightAuto(code);"
+		"	return [result.language || '', result.value];"
+		"})";
+
+	HighlightCache& Highlighter::cache()
+	{
+		static HighlightCache cache;
+
+		return cache;
+	}
+
+	std::string Highlighter::fingerprint(const std::string& highlight_path)
+	{
+		auto path = boost::filesystem::path(highlight_path) / "script.js";
+
+		MappedFile script(path.string());
+
+		return Hash().update(script.data(), script.size()).hex();
+	}
+
+	Highlighter::Highlighter(const std::string& highlight_path)
+	: _isolate(nullptr)
+	{
+		auto path = boost::filesystem::path(highlight_path) / "script.js";
+
+		std::string source;
+
+		try
+		{
+			MappedFile script(path.string());
+
+			source.assign(script.data(), script.size());
+		}
+
+		catch (const FileException&)
+		{
+			throw FileException("Could not load highlight.js!");
+		}
+
+		_fingerprint = Hash().update(source).hex();
+
+		v8::Isolate::CreateParams parameters;
+
+		parameters.array_buffer_allocator = &V8::instance().allocator();
+
+		_isolate = v8::Isolate::New(parameters);
+
+		v8::Isolate::Scope isolate_scope(_isolate);
+
+		v8::HandleScope handle_scope(_isolate);
+
+		auto context = v8::Context::New(_isolate);
+
+		v8::Context::Scope context_scope(context);
+
+		_persistent_context.Reset(_isolate, context);
+
+		auto script = CodeCache::shared().compile(context,
+												  path.string(),
+												  source,
+												  "");
+
+		_execute(script, context);
+
+		auto helper = v8::String::NewFromUtf8(_isolate,
+											  _helper_source.c_str(),
+											  v8::NewStringType::kNormal)
+			.ToLocalChecked();
+
+		auto function = _execute(v8::Script::Compile(context, helper)
+									 .ToLocalChecked(),
+								 context);
+
+		_persistent_helper.Reset(_isolate, function.As<v8::Function>());
+	}
+
+	Highlighter::~Highlighter()
+	{
+		// Handles must not outlive their isolate
+		_persistent_helper.Reset();
+
+		_persistent_context.Reset();
+
+		if (_isolate) _isolate->Dispose();
+	}
+
+	std::string Highlighter::highlight(const std::string& code,
+									   const std::string& language)
+	{
+		auto key = Hash().update(_fingerprint)
+						 .update(language)
+						 .update(code)
+						 .hex();
+
+		std::string html;
+
+		if (cache().find(key, html)) return html;
+
+		v8::Isolate::Scope isolate_scope(_isolate);
+
+		v8::HandleScope handle_scope(_isolate);
+
+		auto context = v8::Local<v8::Context>::New(_isolate,
+												   _persistent_context);
+
+		v8::Context::Scope context_scope(context);
+
+		auto helper = v8::Local<v8::Function>::New(_isolate, _persistent_helper);
+
+		auto new_string = [this] (const std::string& string) {
+			return v8::String::NewFromUtf8(_isolate,
+										   string.data(),
+										   v8::NewStringType::kNormal,
+										   static_cast<int>(string.size()))
+				.ToLocalChecked();
+		};
+
+		v8::Local<v8::Value> arguments[] = {
+			new_string(code),
+			new_string(language)
+		};
+
+		v8::TryCatch try_catch(_isolate);
+
+		auto result = helper->Call(context, context->Global(), 2, arguments);
+
+		if (result.IsEmpty())
+		{
+			auto exception = try_catch.Exception();
+
+			throw ParseException(*static_cast<v8::String::Utf8Value>(exception));
+		}
+
+		auto pair = result.ToLocalChecked().As<v8::Array>();
+
+		std::string detected = *static_cast<v8::String::Utf8Value>(
+			pair->Get(context, 0).ToLocalChecked());
+
+		std::string value = *static_cast<v8::String::Utf8Value>(
+			pair->Get(context, 1).ToLocalChecked());
+
+		// As hljs.initHighlightingOnLoad() leaves it
+		html = "<pre><code class=\"hljs";
+
+		if (! detected.empty()) html += " " + detected;
+
+		html += "\">" + value + "</code></pre>";
+
+		cache().insert(key, html);
+
+		return html;
+	}
+
+	v8::Local<v8::Value>
+	Highlighter::_execute(const v8::Local<v8::Script>& script,
+						  const v8::Local<v8::Context>& context)
+	{
+		v8::EscapableHandleScope handle_scope(_isolate);
+
+		v8::TryCatch try_catch(_isolate);
+
+		auto result = script->Run(context);
+
+		if (result.IsEmpty())
+		{
+			auto exception = try_catch.Exception();
+
+			throw ParseException(*static_cast<v8::String::Utf8Value>(exception));
+		}
+
+		return handle_scope.Escape(result.ToLocalChecked());
+	}
+}
@@ -0,0 +1,377 @@
+#include "markdown-macros.hpp"
+#include "markdown-exceptions.hpp"
+
+#include <cctype>
+
+namespace Markdown
+{
+	namespace
+	{
+		bool is_letter(char character)
+		{
+			return std::isalpha(static_cast<unsigned char>(character));
+		}
+
+		bool is_space(char character)
+		{
+			return character == ' ' || character == '\t' ||
+				   character == '\n' || character == '\r';
+		}
+
+		// Whether the text ends with a control word, e.g. "x + \alpha"
+		bool ends_with_control_word(const std::string& text)
+		{
+			auto position = text.size();
+
+			while (position > 0 && is_letter(text[position - 1])) --position;
+
+			return position > 0 &&
+				   position < text.size() &&
+				   text[position - 1] == '\\';
+		}
+
+		// Skips whitespace and %-comments of a preamble
+		void skip_blank(const std::string& preamble, std::size_t& position)
+		{
+			while (position < preamble.size())
+			{
+				if (is_space(preamble[position])) ++position;
+
+				else if (preamble[position] == '%')
+				{
+					position = preamble.find('\n', position);
+
+					if (position == std::string::npos) position = preamble.size();
+				}
+
+				else break;
+			}
+		}
+	}
+
+	const std::size_t Macros::max_depth = 64;
+
+	const std::size_t Macros::max_size = 1 << 20;
+
+	Macros::Macros(const std::string& preamble)
+	{
+		define(preamble);
+	}
+
+	void Macros::define(const std::string& preamble)
+	{
+		// Only replaces the table once the whole preamble parsed
+		auto table = _table;
+
+		std::size_t position = 0;
+
+		while (true)
+		{
+			skip_blank(preamble, position);
+
+			if (position >= preamble.size()) break;
+
+			if (preamble[position] != '\\')
+			{
+				throw ParseException("Expected a macro definition, found '" +
+									 preamble.substr(position, 20) + "'!");
+			}
+
+			auto command = _control_sequence(preamble, position);
+
+			std::string name;
+
+			Macro macro{0, ""};
+
+			if (command == "\\newcommand" ||
+				command == "\\renewcommand" ||
+				command == "\\providecommand")
+			{
+				if (position < preamble.size() && preamble[position] == '*')
+				{
+					++position;
+				}
+
+				// \newcommand{\name} or \newcommand\name
+				name = _argument(preamble, position, "the name in " + command);
+
+				std::size_t end = 0;
+
+				if (name.empty() ||
+					name[0] != '\\' ||
+					_control_sequence(name, end) != name)
+				{
+					throw ParseException("Invalid macro name '" + name + "'!");
+				}
+
+				skip_blank(preamble, position);
+
+				if (position < preamble.size() && preamble[position] == '[')
+				{
+					auto close = preamble.find(']', position);
+
+					auto count = preamble.substr(position + 1, close - position - 1);
+
+					if (close == std::string::npos ||
+						count.size() != 1 ||
+						count[0] < '1' ||
+						count[0] > '9')
+					{
+						throw ParseException("Invalid number of arguments for " +
+											 name + "!");
+					}
+
+					macro.arguments = count[0] - '0';
+
+					position = close + 1;
+
+					skip_blank(preamble, position);
+
+					if (position < preamble.size() && preamble[position] == '[')
+					{
+						throw ParseException("Optional arguments (of " + name +
+											 ") are not supported!");
+					}
+				}
+
+				macro.body = _argument(preamble, position, "the definition of " + name);
+
+				if (command == "\\providecommand" && table.count(name)) continue;
+			}
+
+			else if (command == "\\def" || command == "\\gdef")
+			{
+				skip_blank(preamble, position);
+
+				if (position >= preamble.size() || preamble[position] != '\\')
+				{
+					throw ParseException("Expected a macro name after " + command + "!");
+				}
+
+				name = _control_sequence(preamble, position);
+
+				// Only undelimited parameters: #1#2...
+				while (position + 1 < preamble.size() &&
+					   preamble[position] == '#' &&
+					   preamble[position + 1] == static_cast<char>('1' + macro.arguments))
+				{
+					++macro.arguments;
+
+					position += 2;
+				}
+
+				if (position >= preamble.size() || preamble[position] != '{')
+				{
+					throw ParseException("Unsupported parameters of " + name + "!");
+				}
+
+				macro.body = _argument(preamble, position, "the definition of " + name);
+			}
+
+			else
+			{
+				throw ParseException("Unsupported command '" + command +
+									 "' in the macro preamble!");
+			}
+
+			table[name] = std::move(macro);
+		}
+
+		_table.swap(table);
+	}
+
+	std::string Macros::expand(const std::string& expression) const
+	{
+		if (_table.empty() || expression.find('\\') == std::string::npos)
+		{
+			return expression;
+		}
+
+		std::string result;
+
+		result.reserve(expression.size());
+
+		_expand(expression, 0, result);
+
+		return result;
+	}
+
+	bool Macros::empty() const noexcept
+	{
+		return _table.empty();
+	}
+
+	std::size_t Macros::size() const noexcept
+	{
+		return _table.size();
+	}
+
+	void Macros::_expand(const std::string& text,
+						 std::size_t depth,
+						 std::string& result) const
+	{
+		if (depth > max_depth)
+		{
+			throw ParseException("Macros nested too deeply (is one recursive?)!");
+		}
+
+		std::size_t position = 0;
+
+		while (position < text.size())
+		{
+			auto backslash = text.find('\\', position);
+
+			if (backslash == std::string::npos)
+			{
+				result.append(text, position, std::string::npos);
+
+				break;
+			}
+
+			result.append(text, position, backslash - position);
+
+			position = backslash;
+
+			auto name = _control_sequence(text, position);
+
+			auto macro = _table.find(name);
+
+			if (macro == _table.end())
+			{
+				result += name;
+
+				continue;
+			}
+
+			std::vector<std::string> arguments;
+
+			for (std::size_t index = 1; index <= macro->second.arguments; ++index)
+			{
+				arguments.push_back(_argument(text,
+											  position,
+											  "argument " + std::to_string(index) +
+											  " of " + name));
+			}
+
+			_expand(_substitute(macro->second.body, arguments), depth + 1, result);
+
+			if (result.size() > max_size)
+			{
+				throw ParseException("The expansion of " + name + " is too large!");
+			}
+
+			// Keep e.g. \alpha from running into the letters after the macro
+			if (position < text.size() &&
+				is_letter(text[position]) &&
+				ends_with_control_word(result))
+			{
+				result += ' ';
+			}
+		}
+	}
+
+	std::string Macros::_substitute(const std::string& body,
+									const std::vector<std::string>& arguments)
+	{
+		if (arguments.empty()) return body;
+
+		std::string result;
+
+		result.reserve(body.size());
+
+		for (std::size_t index = 0; index < body.size(); ++index)
+		{
+			if (body[index] == '#' && index + 1 < body.size())
+			{
+				auto next = body[index + 1];
+
+				if (next == '#')
+				{
+					result += '#';
+
+					++index;
+
+					continue;
+				}
+
+				if (next >= '1' && next <= '9' &&
+					static_cast<std::size_t>(next - '0') <= arguments.size())
+				{
+					result += arguments[next - '1'];
+
+					++index;
+
+					continue;
+				}
+			}
+
+			result += body[index];
+		}
+
+		return result;
+	}
+
+	std::string Macros::_control_sequence(const std::string& text,
+										  std::size_t& position)
+	{
+		auto begin = position++;
+
+		if (position < text.size() && is_letter(text[position]))
+		{
+			while (position < text.size() && is_letter(text[position])) ++position;
+		}
+
+		// A control symbol, e.g. \{ or \\ (a lone backslash at the end is kept)
+		else if (position < text.size()) ++position;
+
+		return text.substr(begin, position - begin);
+	}
+
+	std::string Macros::_argument(const std::string& text,
+								  std::size_t& position,
+								  const std::string& what)
+	{
+		while (position < text.size() && is_space(text[position])) ++position;
+
+		if (position >= text.size() || text[position] == '}')
+		{
+			throw ParseException("Missing " + what + "!");
+		}
+
+		if (text[position] == '\\') return _control_sequence(text, position);
+
+		if (text[position] != '{')
+		{
+			auto begin = position++;
+
+			// A whole UTF-8 character
+			while (position < text.size() &&
+				   (static_cast<unsigned char>(text[position]) & 0xC0) == 0x80)
+			{
+				++position;
+			}
+
+			return text.substr(begin, position - begin);
+		}
+
+		std::size_t depth = 0;
+
+		for (auto index = position; index < text.size(); ++index)
+		{
+			if (text[index] == '\\') ++index;
+
+			else if (text[index] == '{') ++depth;
+
+			else if (text[index] == '}' && --depth == 0)
+			{
+				auto argument = text.substr(position + 1, index - position - 1);
+
+				position = index + 1;
+
+				return argument;
+			}
+		}
+
+		throw ParseException("Unclosed group in " + what + "!");
+	}
+}
@@ -0,0 +1,135 @@
+#include "markdown-manifest.hpp"
+#include "markdown-exceptions.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace Markdown
+{
+	namespace
+	{
+		// Escapes the separators (and backslashes) of a field
+		std::string escape(const std::string& field)
+		{
+			std::string escaped;
+
+			for (auto character : field)
+			{
+				if (character == '\\') escaped += "\\\\";
+
+				else if (character == '\t') escaped += "\\t";
+
+				else if (character == '\n') escaped += "\\n";
+
+				else escaped += character;
+			}
+
+			return escaped;
+		}
+
+		std::string unescape(const std::string& field)
+		{
+			std::string unescaped;
+
+			for (std::size_t index = 0; index < field.size(); ++index)
+			{
+				if (field[index] == '\\' && index + 1 < field.size())
+				{
+					auto next = field[++index];
+
+					if (next == 't') unescaped += '\t';
+
+					else if (next == 'n') unescaped += '\n';
+
+					else unescaped += next;
+				}
+
+				else unescaped += field[index];
+			}
+
+			return unescaped;
+		}
+	}
+
+	Manifest::Manifest(const std::string& path)
+	: _path(path)
+	{
+		std::ifstream file(path);
+
+		std::string line;
+
+		while (std::getline(file, line))
+		{
+			std::istringstream fields(line);
+
+			std::string output;
+
+			Entry entry;
+
+			if (std::getline(fields, output, '\t') &&
+				std::getline(fields, entry.input, '\t') &&
+				std::getline(fields, entry.input_hash, '\t') &&
+				std::getline(fields, entry.settings_hash))
+			{
+				entry.input = unescape(entry.input);
+
+				_entries[unescape(output)] = entry;
+			}
+		}
+	}
+
+	const Manifest::Entry* Manifest::find(const std::string& output) const
+	{
+		auto entry = _entries.find(output);
+
+		return entry == _entries.end() ? nullptr : &entry->second;
+	}
+
+	void Manifest::update(const std::string& output, const Entry& entry)
+	{
+		_entries[output] = entry;
+	}
+
+	void Manifest::erase(const std::string& output)
+	{
+		_entries.erase(output);
+	}
+
+	const Manifest::entries_t& Manifest::entries() const
+	{
+		return _entries;
+	}
+
+	void Manifest::save() const
+	{
+		auto temporary = _path + ".tmp";
+
+		{
+			std::ofstream file(temporary, std::ios::trunc);
+
+			for (const auto& entry : _entries)
+			{
+				file << escape(entry.first) << '\t'
+					 << escape(entry.second.input) << '\t'
+					 << entry.second.input_hash << '\t'
+					 << entry.second.settings_hash << '\n';
+			}
+
+			if (! file)
+			{
+				throw FileException("Could not write file '" + temporary + "'!");
+			}
+		}
+
+		if (std::rename(temporary.c_str(), _path.c_str()) != 0)
+		{
+			throw FileException("Could not write file '" + _path + "'!");
+		}
+	}
+
+	const std::string& Manifest::path() const
+	{
+		return _path;
+	}
+}
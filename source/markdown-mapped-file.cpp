@@ -0,0 +1,148 @@
+#include "markdown-mapped-file.hpp"
+#include "markdown-exceptions.hpp"
+
+#include <cctype>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Markdown
+{
+	const std::size_t MappedFile::mapping_threshold = 1 << 16;
+
+	MappedFile::MappedFile(const std::string& path)
+	: _data(nullptr)
+	, _size(0)
+	, _mapped(false)
+	{
+		auto descriptor = ::open(path.c_str(), O_RDONLY);
+
+		if (descriptor < 0)
+		{
+			throw FileException("Could not open file '" + path + "'!");
+		}
+
+		struct stat status;
+
+		if (::fstat(descriptor, &status) != 0)
+		{
+			::close(descriptor);
+
+			throw FileException("Could not open file '" + path + "'!");
+		}
+
+		std::size_t size = S_ISREG(status.st_mode) ? status.st_size : 0;
+
+		if (size >= mapping_threshold)
+		{
+			auto mapping = ::mmap(nullptr,
+								  size,
+								  PROT_READ,
+								  MAP_PRIVATE,
+								  descriptor,
+								  0);
+
+			if (mapping != MAP_FAILED)
+			{
+				::madvise(mapping, size, MADV_SEQUENTIAL);
+
+				_data = static_cast<const char*>(mapping);
+
+				_size = size;
+
+				_mapped = true;
+			}
+		}
+
+		// Small files (or pipes, or failed mappings) are read at once
+		if (! _mapped && ! _read(descriptor, size))
+		{
+			::close(descriptor);
+
+			throw FileException("Could not read file '" + path + "'!");
+		}
+
+		::close(descriptor);
+
+		// The get-area is never written to by std::streambuf
+		auto begin = const_cast<char*>(_data);
+
+		setg(begin, begin, begin + _size);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (_mapped)
+		{
+			::munmap(const_cast<char*>(_data), _size);
+		}
+	}
+
+	const char* MappedFile::data() const noexcept
+	{
+		return _data;
+	}
+
+	std::size_t MappedFile::size() const noexcept
+	{
+		return _size;
+	}
+
+	std::size_t MappedFile::trimmed_size() const noexcept
+	{
+		auto size = _size;
+
+		while (size > 0 && std::isspace(static_cast<unsigned char>(_data[size - 1])))
+		{
+			--size;
+		}
+
+		return size;
+	}
+
+	bool MappedFile::mapped() const noexcept
+	{
+		return _mapped;
+	}
+
+	bool MappedFile::_read(int descriptor, std::size_t size)
+	{
+		// Unknown sizes (e.g. pipes) are read in growing steps
+		_buffer.resize(size ? size : 4096);
+
+		std::size_t total = 0;
+
+		while (true)
+		{
+			if (total == _buffer.size())
+			{
+				// A known size was read completely
+				if (size) break;
+
+				_buffer.resize(_buffer.size() * 2);
+			}
+
+			auto count = ::read(descriptor,
+								&_buffer[total],
+								_buffer.size() - total);
+
+			if (count < 0 && errno == EINTR) continue;
+
+			if (count < 0) return false;
+
+			if (count == 0) break;
+
+			total += count;
+		}
+
+		_buffer.resize(total);
+
+		_data = _buffer.data();
+
+		_size = total;
+
+		return true;
+	}
+}
@@ -1,5 +1,6 @@
 #include "markdown-markdown.hpp"
 
+#include <cstdint>
 #include <hoedown/html.h>
 #include <hoedown/document.h>
 
@@ -92,6 +93,11 @@ namespace Markdown
 	}
 	
 	std::string Markdown::render(const std::string& markdown)
+	{
+		return render(markdown.data(), markdown.size());
+	}
+	
+	std::string Markdown::render(const char* markdown, std::size_t size)
 	{
 		static const std::size_t nesting_depth = 16;
 		
@@ -99,14 +105,14 @@ namespace Markdown
 											 _load_extensions(),
 											 nesting_depth);
 		
-		_buffer = _verify_buffer_size(markdown.size());
-		
-		auto data = _to_uint8_string(markdown);
+		_buffer = _verify_buffer_size(size);
 		
 		hoedown_document_render(document,
 								_buffer,
-								data.get(),
-								markdown.size());
+								reinterpret_cast<const std::uint8_t*>(markdown),
+								size);
+		
+		hoedown_document_free(document);
 		
 		auto result = _buffer_to_string(_buffer);
 		
@@ -145,16 +151,6 @@ namespace Markdown
 		return _buffer;
 	}
 	
-	inline std::unique_ptr<std::uint8_t[]>
-	Markdown::_to_uint8_string(const std::string &string) const
-	{
-		auto result = std::make_unique<std::uint8_t[]>(string.size());
-		
-		std::copy(string.begin(), string.end(), result.get());
-		
-		return result;
-	}
-	
 	inline std::string
 	Markdown::_buffer_to_string(const hoedown_buffer *buffer) const
 	{
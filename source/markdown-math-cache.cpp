@@ -0,0 +1,247 @@
+#include "markdown-math-cache.hpp"
+
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+namespace Markdown
+{
+	const std::size_t MathCache::default_capacity = 64 << 20;
+
+	double MathCache::Statistics::hit_rate() const noexcept
+	{
+		auto lookups = hits + disk_hits + misses;
+
+		return lookups ? static_cast<double>(hits + disk_hits) / lookups : 0;
+	}
+
+	std::string MathCache::Statistics::to_string() const
+	{
+		std::ostringstream stream;
+
+		stream << std::fixed << std::setprecision(3)
+			   << "math-cache-hits: " << hits << "\n"
+			   << "math-cache-disk-hits: " << disk_hits << "\n"
+			   << "math-cache-misses: " << misses << "\n"
+			   << "math-cache-hit-rate: " << hit_rate() << "\n"
+			   << "math-cache-evictions: " << evictions << "\n"
+			   << "math-cache-entries: " << entries << "\n"
+			   << "math-cache-bytes: " << bytes << "\n";
+
+		return stream.str();
+	}
+
+	MathCache& MathCache::shared()
+	{
+		static MathCache cache;
+
+		return cache;
+	}
+
+	MathCache::MathCache(std::size_t capacity, const std::string& directory)
+	: _capacity(capacity)
+	, _directory(directory)
+	, _statistics{0, 0, 0, 0, 0, 0}
+	{ }
+
+	bool MathCache::find(const std::string& key, std::string& html)
+	{
+		std::string directory;
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			auto entry = _index.find(key);
+
+			if (entry != _index.end())
+			{
+				// Move to the front (most recently used)
+				_entries.splice(_entries.begin(), _entries, entry->second);
+
+				html = entry->second->second;
+
+				++_statistics.hits;
+
+				return true;
+			}
+
+			directory = _directory;
+		}
+
+		if (! directory.empty())
+		{
+			std::ifstream file(_file(directory, key), std::ios::binary);
+
+			if (file)
+			{
+				html.assign(std::istreambuf_iterator<char>(file),
+							std::istreambuf_iterator<char>());
+
+				std::lock_guard<std::mutex> lock(_mutex);
+
+				_remember(key, html);
+
+				++_statistics.disk_hits;
+
+				return true;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		++_statistics.misses;
+
+		return false;
+	}
+
+	void MathCache::insert(const std::string& key, const std::string& html)
+	{
+		std::string directory;
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			_remember(key, html);
+
+			directory = _directory;
+		}
+
+		if (directory.empty()) return;
+
+		auto path = _file(directory, key);
+
+		boost::system::error_code error;
+
+		boost::filesystem::create_directories(
+			boost::filesystem::path(path).parent_path(),
+			error);
+
+		// Other threads (or processes) may be storing the same entry
+		std::ostringstream temporary;
+
+		temporary << path << "." << ::getpid() << "."
+				  << std::this_thread::get_id() << ".tmp";
+
+		std::ofstream file(temporary.str(), std::ios::binary | std::ios::trunc);
+
+		file << html;
+
+		file.close();
+
+		if (! file || std::rename(temporary.str().c_str(), path.c_str()) != 0)
+		{
+			std::remove(temporary.str().c_str());
+		}
+	}
+
+	void MathCache::capacity(std::size_t capacity)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_capacity = capacity;
+
+		_evict();
+	}
+
+	std::size_t MathCache::capacity() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		return _capacity;
+	}
+
+	void MathCache::directory(const std::string& directory)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_directory = directory;
+	}
+
+	std::string MathCache::directory() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		return _directory;
+	}
+
+	void MathCache::clear()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_entries.clear();
+
+		_index.clear();
+
+		_statistics.entries = 0;
+
+		_statistics.bytes = 0;
+	}
+
+	MathCache::Statistics MathCache::statistics() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		return _statistics;
+	}
+
+	void MathCache::_remember(const std::string& key, const std::string& html)
+	{
+		auto entry = _index.find(key);
+
+		if (entry != _index.end())
+		{
+			_statistics.bytes -= entry->second->second.size();
+
+			entry->second->second = html;
+
+			_entries.splice(_entries.begin(), _entries, entry->second);
+		}
+
+		else
+		{
+			_entries.emplace_front(key, html);
+
+			_index.emplace(key, _entries.begin());
+
+			_statistics.bytes += key.size();
+
+			++_statistics.entries;
+		}
+
+		_statistics.bytes += html.size();
+
+		_evict();
+	}
+
+	void MathCache::_evict()
+	{
+		while (_statistics.bytes > _capacity && ! _entries.empty())
+		{
+			const auto& oldest = _entries.back();
+
+			_statistics.bytes -= oldest.first.size() + oldest.second.size();
+
+			_index.erase(oldest.first);
+
+			_entries.pop_back();
+
+			--_statistics.entries;
+
+			++_statistics.evictions;
+		}
+	}
+
+	std::string MathCache::_file(const std::string& directory,
+								 const std::string& key)
+	{
+		// Spread over subdirectories, as large corpora have many equations
+		auto path = boost::filesystem::path(directory) / key.substr(0, 2);
+
+		return (path / (key + ".html")).string();
+	}
+}
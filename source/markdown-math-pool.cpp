@@ -0,0 +1,241 @@
+#include "markdown-math-pool.hpp"
+#include "markdown-math.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace Markdown
+{
+	MathPool::MathPool(const std::string& katex_path, std::size_t size)
+	: MathPool([katex_path] { return std::make_unique<Math>(katex_path); },
+			   size,
+			   Math::default_settings)
+	{ }
+
+	MathPool::MathPool(const factory_t& factory,
+					   std::size_t size,
+					   const Configurable::settings_t& settings)
+	: AbstractMath(settings)
+	, _batch(0)
+	, _busy(0)
+	, _ready(0)
+	, _stopping(false)
+	, _expressions(nullptr)
+	, _next(0)
+	{
+		if (size == 0)
+		{
+			size = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		for (std::size_t worker = 0; worker < size; ++worker)
+		{
+			_threads.emplace_back(&MathPool::_work, this, factory);
+		}
+
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		_finished.wait(lock, [this] { return _ready == _threads.size(); });
+
+		if (_failure)
+		{
+			_stopping = true;
+
+			lock.unlock();
+
+			_started.notify_all();
+
+			for (auto& thread : _threads) thread.join();
+
+			std::rethrow_exception(_failure);
+		}
+	}
+
+	MathPool::~MathPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			_stopping = true;
+		}
+
+		_started.notify_all();
+
+		for (auto& thread : _threads) thread.join();
+	}
+
+	std::string MathPool::render(const std::string& expression,
+								 bool display_math)
+	{
+		std::vector<expression_t> expressions = {{expression, display_math}};
+
+		return render(expressions).front();
+	}
+
+	std::vector<std::string>
+	MathPool::render(const std::vector<expression_t>& expressions)
+	{
+		if (expressions.empty()) return {};
+
+		std::lock_guard<std::mutex> render_lock(_render_mutex);
+
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		_expressions = &expressions;
+
+		_order.resize(expressions.size());
+
+		std::iota(_order.begin(), _order.end(), 0);
+
+		// Longest (roughly: slowest) first
+		std::stable_sort(_order.begin(),
+						 _order.end(),
+						 [&expressions] (std::size_t first, std::size_t second) {
+			return expressions[first].first.size() >
+				   expressions[second].first.size();
+		});
+
+		_results.assign(expressions.size(), std::string());
+
+		_next = 0;
+
+		_failure = nullptr;
+
+		_busy = _threads.size();
+
+		++_batch;
+
+		lock.unlock();
+
+		_started.notify_all();
+
+		lock.lock();
+
+		_finished.wait(lock, [this] { return _busy == 0; });
+
+		_expressions = nullptr;
+
+		if (_failure)
+		{
+			auto failure = _failure;
+
+			_failure = nullptr;
+
+			std::rethrow_exception(failure);
+		}
+
+		return std::move(_results);
+	}
+
+	std::size_t MathPool::size() const noexcept
+	{
+		return _threads.size();
+	}
+
+	std::string MathPool::fingerprint() const
+	{
+		return _fingerprint;
+	}
+
+	void MathPool::_work(const factory_t& factory)
+	{
+		std::unique_ptr<AbstractMath> engine;
+
+		std::string fingerprint;
+
+		try
+		{
+			engine = factory();
+
+			fingerprint = engine->fingerprint();
+		}
+
+		catch (...)
+		{
+			engine.reset();
+
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			if (! _failure) _failure = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			_fingerprint = fingerprint;
+
+			++_ready;
+		}
+
+		_finished.notify_all();
+
+		if (! engine) return;
+
+		std::size_t batch = 0;
+
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+
+				_started.wait(lock, [this, batch] {
+					return _stopping || _batch != batch;
+				});
+
+				if (_stopping) return;
+
+				batch = _batch;
+
+				// The pool's settings cannot change during a batch
+				engine->settings(Configurable::settings());
+
+				engine->deadline(_deadline);
+			}
+
+			_drain(*engine);
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+
+				--_busy;
+			}
+
+			_finished.notify_all();
+
+			// A batch is a document, so the pool is idle between batches
+			engine->idle();
+		}
+	}
+
+	void MathPool::_drain(AbstractMath& engine)
+	{
+		const auto& expressions = *_expressions;
+
+		while (true)
+		{
+			auto position = _next++;
+
+			if (position >= _order.size()) return;
+
+			auto index = _order[position];
+
+			try
+			{
+				_results[index] = engine.render(expressions[index].first,
+												expressions[index].second);
+			}
+
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+
+				if (! _failure) _failure = std::current_exception();
+
+				// Hand out no further expressions
+				_next = _order.size();
+
+				return;
+			}
+		}
+	}
+}
@@ -1,51 +1,71 @@
 #include "markdown-math.hpp"
+#include "markdown-code-cache.hpp"
 #include "markdown-exceptions.hpp"
+#include "markdown-v8.hpp"
+#include "markdown-watchdog.hpp"
 
 #include <boost/filesystem.hpp>
-#include <cstring>
-#include <cstdlib>
+#include <boost/optional.hpp>
 #include <fstream>
 #include <iostream>
-#include <libplatform/libplatform.h>
-#include <regex>
 
 namespace Markdown
 {
-	Math::V8 Math::_v8;
+	const std::string Math::_batch_source =
+		"(function (expressions, display) {"
+		"	return expressions.map(function (expression, index) {"
+		"		try {"
+		"			return katex.renderToString(expression, {"
+		"				displayMode: display[index]"
+		"			});"
+		"		} catch (error) {"
+		"			return [String(error)];"
+		"		}"
+		"	});"
+		"})";
+	
+	const std::size_t Math::_heap_check_interval = 64;
 	
 	const Configurable::settings_t Math::default_settings = {
 		{"all-display-math", "0"},
 		{"throw-on-error", "1"},
 		{"error-color", "#CC0000"},
-		{"log-errors", "1"}
+		{"log-errors", "1"},
+		{"snapshot", "1"},
+		{"code-cache", "1"},
+		{"code-cache-directory", ""},
+		{"heap-limit", "0"},
+		{"recycle-renders", "0"},
+		{"recycle-heap", "256"},
+		{"idle-time", "10"}
 	};
 	
 	Math::Math(const std::string& katex_path,
 			   const Configurable::settings_t& settings)
 	: AbstractMath(settings)
-	, _isolate(_new_isolate())
+	, _snapshot(Configurable::get<bool>("snapshot") ?
+				Snapshot::load(katex_path) : nullptr)
+	, _isolate(nullptr)
 	, _katex_path(katex_path)
-	{		
-		v8::HandleScope handle_scope(_isolate);
-		
-		v8::Isolate::Scope isolate_scope(_isolate);
-		
-		auto context = v8::Context::New(_isolate);
-		
-		v8::Context::Scope context_scope(context);
-		
-		_persistent_context = v8::UniquePersistent<v8::Context>(_isolate, context);
-		
-		_load_katex(context);
+	, _renders(0)
+	, _next_heap_check(_heap_check_interval)
+	, _recycles(0)
+	{
+		_start();
 	}
 	
 	Math::Math(const Math& other)
-	: Math(other._katex_path)
+	: Math(other._katex_path, other.settings())
 	{ }
 	
 	Math::Math(Math&& other) noexcept
-	: Math()
+	: AbstractMath(Configurable::settings_t())
+	, _isolate(nullptr)
+	, _renders(0)
+	, _next_heap_check(_heap_check_interval)
+	, _recycles(0)
 	{
+		// No isolate is created for this object, only taken over
 		swap(other);
 	}
 	
@@ -61,11 +81,29 @@ namespace Markdown
 		// Enable ADL
 		using std::swap;
 		
-		swap(_allocator, other._allocator);
+		swap(_settings, other._settings);
+		
+		swap(_snapshot, other._snapshot);
 		
 		swap(_isolate, other._isolate);
 		
 		swap(_persistent_context, other._persistent_context);
+		
+		swap(_persistent_render, other._persistent_render);
+		
+		swap(_persistent_options, other._persistent_options);
+		
+		swap(_persistent_batch, other._persistent_batch);
+		
+		swap(_katex_path, other._katex_path);
+		
+		swap(_fingerprint, other._fingerprint);
+		
+		swap(_renders, other._renders);
+		
+		swap(_next_heap_check, other._next_heap_check);
+		
+		swap(_recycles, other._recycles);
 	}
 	
 	void swap(Math& first, Math& second) noexcept
@@ -73,11 +111,21 @@ namespace Markdown
 		first.swap(second);
 	}
 	
-	Math::~Math() = default;
+	Math::~Math()
+	{
+		_stop();
+	}
 	
 	std::string Math::render(const std::string &expression,
 							 bool display_math)
 	{
+		// Too late to start the engine (and to finish the render)
+		if (_deadline.expired()) return _handle_error(expression);
+		
+		_recycle_if_due();
+		
+		++_renders;
+		
 		v8::Isolate::Scope isolate_scope(_isolate);
 		
 		// Stack-allocated handle-scope (takes care of handles such
@@ -90,13 +138,23 @@ namespace Markdown
 		
 		v8::Context::Scope context_scope(context);
 		
-		auto source = _get_javascript(expression, display_math);
+		// all-display-math | display_math | result
+		// 		 0		    |	  0		   |   0
+		// 		 0		    |	  1		   |   1
+		// 		 1		    |	  0		   |   1
+		// 		 1		    |	  1		   |   1
+		display_math |= Configurable::get<bool>("all-display-math");
+		
+		auto render = v8::Local<v8::Function>::New(_isolate, _persistent_render);
+		
+		auto options = v8::Local<v8::Object>::New(_isolate,
+												  _persistent_options[display_math]);
 		
 		v8::Local<v8::Value> value;
 		
 		try
 		{
-			value = _run(source, context);
+			value = _call(render, {_new_string(expression), options}, context);
 		}
 		
 		catch(const ParseException& exception)
@@ -109,11 +167,104 @@ namespace Markdown
 			else throw exception;
 		}
 		
+		catch(const TimeoutException&)
+		{
+			return _handle_error(expression);
+		}
+		
 		std::string html = *static_cast<v8::String::Utf8Value>(value);
 		
 		return "<span class='math'>\n" + html + "</span>\n";
 	}
 	
+	std::vector<std::string>
+	Math::render(const std::vector<expression_t>& expressions)
+	{
+		if (expressions.empty()) return {};
+		
+		if (_deadline.expired()) return _handle_errors(expressions);
+		
+		_recycle_if_due();
+		
+		_renders += expressions.size();
+		
+		v8::Isolate::Scope isolate_scope(_isolate);
+		
+		v8::HandleScope handle_scope(_isolate);
+		
+		auto context = v8::Local<v8::Context>::New(_isolate,
+												   _persistent_context);
+		
+		v8::Context::Scope context_scope(context);
+		
+		auto all_display_math = Configurable::get<bool>("all-display-math");
+		
+		auto size = static_cast<int>(expressions.size());
+		
+		auto sources = v8::Array::New(_isolate, size);
+		
+		auto display = v8::Array::New(_isolate, size);
+		
+		for (int index = 0; index < size; ++index)
+		{
+			const auto& expression = expressions[index];
+			
+			sources->Set(context, index, _new_string(expression.first)).FromJust();
+			
+			auto flag = v8::Boolean::New(_isolate,
+										 expression.second || all_display_math);
+			
+			display->Set(context, index, flag).FromJust();
+		}
+		
+		v8::Local<v8::Value> value;
+		
+		try
+		{
+			value = _call(_batch_function(context), {sources, display}, context);
+		}
+		
+		// The batch is all-or-nothing
+		catch(const TimeoutException&)
+		{
+			return _handle_errors(expressions);
+		}
+		
+		auto results = value.As<v8::Array>();
+		
+		std::vector<std::string> html;
+		
+		html.reserve(expressions.size());
+		
+		for (int index = 0; index < size; ++index)
+		{
+			auto result = results->Get(context, index).ToLocalChecked();
+			
+			// Failures come back as [message]
+			if (result->IsString())
+			{
+				std::string rendered = *static_cast<v8::String::Utf8Value>(result);
+				
+				html.push_back("<span class='math'>\n" + rendered + "</span>\n");
+			}
+			
+			else if (! Configurable::get<bool>("throw-on-error"))
+			{
+				html.push_back(_handle_error(expressions[index].first));
+			}
+			
+			else
+			{
+				std::string what = *static_cast<v8::String::Utf8Value>(result);
+				
+				// Remove the 'ParseError' (redundant)
+				throw ParseException(what.substr(12));
+			}
+		}
+		
+		return html;
+	}
+	
 	const std::string& Math::katex_path() const noexcept
 	{
 		return _katex_path;
@@ -123,6 +274,8 @@ namespace Markdown
 	{
 		_katex_path = path;
 		
+		_fingerprint.clear();
+		
 		v8::Isolate::Scope isolate_scope(_isolate);
 		
 		v8::HandleScope handle_scope(_isolate);
@@ -131,14 +284,150 @@ namespace Markdown
 		auto context = v8::Local<v8::Context>::New(_isolate,
 												   _persistent_context);
 		
+		v8::Context::Scope context_scope(context);
+		
 		_load_katex(context);
+		
+		_bind_katex(context);
+	}
+	
+	std::string Math::fingerprint() const
+	{
+		if (_fingerprint.empty())
+		{
+			_fingerprint = Snapshot::katex_hash(_katex_path);
+		}
+		
+		return _fingerprint;
+	}
+	
+	Math::HeapStatistics Math::heap_statistics() const
+	{
+		v8::HeapStatistics statistics;
+		
+		_isolate->GetHeapStatistics(&statistics);
+		
+		return {
+			statistics.total_heap_size(),
+			statistics.used_heap_size(),
+			statistics.total_physical_size(),
+			statistics.heap_size_limit(),
+			_renders,
+			_recycles
+		};
+	}
+	
+	void Math::idle()
+	{
+		// Between documents is the cheapest time to start over
+		// (and to measure the heap, off any render's latency)
+		_next_heap_check = _renders;
+		
+		_recycle_if_due();
+		
+		v8::Isolate::Scope isolate_scope(_isolate);
+		
+		auto statistics = heap_statistics();
+		
+		if (statistics.used > statistics.limit / 2)
+		{
+			// Collects everything it can (expensive, but memory is short)
+			_isolate->LowMemoryNotification();
+		}
+		
+		else
+		{
+			auto seconds = Configurable::get<double>("idle-time") / 1000;
+			
+			auto now = V8::instance().platform().MonotonicallyIncreasingTime();
+			
+			_isolate->IdleNotificationDeadline(now + seconds);
+		}
+	}
+	
+	void Math::_start()
+	{
+		_isolate = _new_isolate();
+		
+		v8::HandleScope handle_scope(_isolate);
+		
+		v8::Isolate::Scope isolate_scope(_isolate);
+		
+		// Deserialized from the snapshot, if any, with KaTeX loaded
+		auto context = v8::Context::New(_isolate);
+		
+		v8::Context::Scope context_scope(context);
+		
+		_persistent_context = v8::UniquePersistent<v8::Context>(_isolate, context);
+		
+		if (! _snapshot) _load_katex(context);
+		
+		_bind_katex(context);
+	}
+	
+	void Math::_stop()
+	{
+		if (! _isolate) return;
+		
+		// Handles must not outlive their isolate
+		_persistent_batch.Reset();
+		
+		for (auto& options : _persistent_options) options.Reset();
+		
+		_persistent_render.Reset();
+		
+		_persistent_context.Reset();
+		
+		_isolate->Dispose();
+		
+		_isolate = nullptr;
+	}
+	
+	void Math::_recycle_if_due()
+	{
+		auto renders = Configurable::get<std::size_t>("recycle-renders");
+		
+		auto heap = Configurable::get<std::size_t>("recycle-heap") << 20;
+		
+		bool heap_full = false;
+		
+		// Not before every render (V8's GetHeapStatistics is not free)
+		if (heap && _renders >= _next_heap_check)
+		{
+			heap_full = heap_statistics().used >= heap;
+			
+			_next_heap_check = _renders + _heap_check_interval;
+		}
+		
+		if ((renders && _renders >= renders) || heap_full)
+		{
+			_stop();
+			
+			_start();
+			
+			_renders = 0;
+			
+			_next_heap_check = _heap_check_interval;
+			
+			++_recycles;
+		}
 	}
 	
 	v8::Isolate* Math::_new_isolate() const
 	{
 		v8::Isolate::CreateParams parameters;
 		
-		parameters.array_buffer_allocator = &_allocator;
+		parameters.array_buffer_allocator = &V8::instance().allocator();
+		
+		auto heap_limit = Configurable::get<int>("heap-limit");
+		
+		// In MiB, for the old generation (where KaTeX's objects live)
+		if (heap_limit > 0)
+		{
+			parameters.constraints.set_max_old_space_size(heap_limit);
+		}
+		
+		if (_snapshot) parameters.snapshot_blob = _snapshot->blob();
 		
 		// Isolated JavaScript Virtual Environment
 		return v8::Isolate::New(parameters);
@@ -158,6 +447,15 @@ namespace Markdown
 		// Compile the source code.
 		auto script = v8::Script::Compile(context, checked).ToLocalChecked();
 		
+		// Allows us to return local-scope objects to the outside scope
+		return handle_scope.Escape(_execute(script, context));
+	}
+	
+	v8::Local<v8::Value> Math::_execute(const v8::Local<v8::Script>& script,
+										 const v8::Local<v8::Context>& context) const
+	{
+		v8::EscapableHandleScope handle_scope(_isolate);
+		
 		// V8 engine's try-catch mechanism
 		v8::TryCatch try_catch(_isolate);
 		
@@ -174,42 +472,104 @@ namespace Markdown
 			throw ParseException(what.substr(12));
 		}
 		
-		// Allows us to return local-scope objects to the outside scope
 		return handle_scope.Escape(result.ToLocalChecked());
 	}
 	
-	std::string Math::_get_javascript(const std::string &expression,
-									  bool display_math) const
+	v8::Local<v8::Value> Math::_call(const v8::Local<v8::Function>& function,
+									  std::vector<v8::Local<v8::Value>> arguments,
+									  const v8::Local<v8::Context>& context) const
 	{
-		std::string source = "katex.renderToString('";
+		v8::EscapableHandleScope handle_scope(_isolate);
 		
-		source += _escape(expression);
+		v8::TryCatch try_catch(_isolate);
 		
-		source += "', {'displayMode': ";
+		boost::optional<Watchdog::Guard> watchdog;
 		
-		// all-display-math | display_math | result
-		// 		 0		    |	  0		   |   0
-		// 		 0		    |	  1		   |   1
-		// 		 1		    |	  0		   |   1
-		// 		 1		    |	  1		   |   1
-		display_math |= Configurable::get<bool>("all-display-math");
+		// Interrupts KaTeX (from the watchdog's thread) once the deadline
+		// expired, unless it never does (then the watchdog is not needed)
+		if (_deadline.watched())
+		{
+			auto isolate = _isolate;
+			
+			watchdog.emplace(_deadline, [isolate] {
+				isolate->TerminateExecution();
+			});
+		}
+		
+		auto result = function->Call(context,
+									 context->Global(),
+									 static_cast<int>(arguments.size()),
+									 arguments.data());
 		
-		source += display_math ? "true})" : "false})";
+		// The termination may have come after the call returned,
+		// in which case it must not hit the next call instead
+		if (watchdog && watchdog->release()) _isolate->CancelTerminateExecution();
+		
+		if (result.IsEmpty())
+		{
+			if (try_catch.HasTerminated())
+			{
+				throw TimeoutException("Deadline expired while rendering math!");
+			}
+			
+			auto exception = try_catch.Exception();
+			
+			std::string what = *static_cast<v8::String::Utf8Value>(exception);
+			
+			// Remove the 'ParseError' (redundant)
+			throw ParseException(what.substr(12));
+		}
 		
-		return source;
+		return handle_scope.Escape(result.ToLocalChecked());
+	}
+	
+	v8::Local<v8::String> Math::_new_string(const std::string& string) const
+	{
+		return v8::String::NewFromUtf8(_isolate,
+									   string.data(),
+									   v8::NewStringType::kNormal,
+									   static_cast<int>(string.size()))
+			.ToLocalChecked();
 	}
 	
-	std::string Math::_escape(std::string source) const
+	void Math::_bind_katex(const v8::Local<v8::Context>& context)
 	{
-		static const std::regex bad_backslashes("(?:\\\\)+(\\s|$)");
-		static const std::regex good_backslashes("\\\\");
-		static const std::regex space("[\\t\\n]+");
+		v8::HandleScope handle_scope(_isolate);
+		
+		auto katex = context->Global()->Get(context, _new_string("katex"))
+									  .ToLocalChecked()
+									  .As<v8::Object>();
 		
-		source = std::regex_replace(source, bad_backslashes, "$1");
-		source = std::regex_replace(source, good_backslashes, "\\\\");
-		source = std::regex_replace(source, space, "");
+		auto render = katex->Get(context, _new_string("renderToString"))
+						   .ToLocalChecked()
+						   .As<v8::Function>();
 		
-		return source;
+		_persistent_render.Reset(_isolate, render);
+		
+		// Reused for every expression (KaTeX only reads them)
+		for (bool display_math : {false, true})
+		{
+			auto options = v8::Object::New(_isolate);
+			
+			options->Set(context,
+						 _new_string("displayMode"),
+						 v8::Boolean::New(_isolate, display_math)).FromJust();
+			
+			_persistent_options[display_math].Reset(_isolate, options);
+		}
+	}
+	
+	v8::Local<v8::Function>
+	Math::_batch_function(const v8::Local<v8::Context>& context)
+	{
+		if (_persistent_batch.IsEmpty())
+		{
+			auto function = _run(_batch_source, context).As<v8::Function>();
+			
+			_persistent_batch.Reset(_isolate, function);
+		}
+		
+		return v8::Local<v8::Function>::New(_isolate, _persistent_batch);
 	}
 	
 	void Math::_load_katex(const v8::Local<v8::Context>& context) const
@@ -231,7 +591,23 @@ namespace Markdown
 				  std::istreambuf_iterator<char>{},
 				  std::back_inserter(source));
 		
-		_run(source, context);
+		if (! Configurable::get<bool>("code-cache"))
+		{
+			_run(source, context);
+			
+			return;
+		}
+		
+		v8::HandleScope handle_scope(_isolate);
+		
+		const auto& directory = Configurable::operator[]("code-cache-directory");
+		
+		auto script = CodeCache::shared().compile(context,
+												  path.string(),
+												  source,
+												  directory);
+		
+		_execute(script, context);
 	}
 	
 	std::string Math::_handle_error(const std::string &expression) const
@@ -252,37 +628,18 @@ namespace Markdown
 		return html;
 	}
 	
-	void* Math::Allocator::Allocate(std::size_t length)
+	std::vector<std::string>
+	Math::_handle_errors(const std::vector<expression_t>& expressions) const
 	{
-		auto data = AllocateUninitialized(length);
+		std::vector<std::string> html;
 		
-		return data ? std::memset(data, 0, length) : data;
-	}
-	
-	void Math::Allocator::Free(void *data, std::size_t)
-	{
-		free(data);
-	}
-	
-	void* Math::Allocator::AllocateUninitialized(std::size_t length)
-	{
-		return malloc(length);
-	}
-	
-	Math::V8::V8()
-	: platform(v8::platform::CreateDefaultPlatform())
-	{
-		v8::V8::InitializeICU();
+		html.reserve(expressions.size());
 		
-		v8::V8::InitializePlatform(platform.get());
-		
-		v8::V8::Initialize();
-	}
-	
-	Math::V8::~V8()
-	{
-		v8::V8::Dispose();
+		for (const auto& expression : expressions)
+		{
+			html.push_back(_handle_error(expression.first));
+		}
 		
-		v8::V8::ShutdownPlatform();
+		return html;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,1528 @@
+#include "markdown-native-math.hpp"
+#include "markdown-exceptions.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <unordered_map>
+#include <utility>
+
+namespace Markdown
+{
+	namespace
+	{
+		/*! The alphabets of \mathbb, \mathcal, \mathbf etc. */
+		enum class Font
+		{
+			none,
+			roman,
+			italic,
+			bold,
+			bold_italic,
+			script,
+			fraktur,
+			double_struck,
+			sans_serif,
+			monospace
+		};
+
+		/*! Converted LaTeX that sub- and superscripts can be attached to. */
+		struct Node
+		{
+			/*! A single MathML element. */
+			std::string mathml;
+
+			/*! Whether scripts go below and above (rather than beside). */
+			bool limits;
+
+			/*! MathML that follows the scripts (if any). */
+			std::string after;
+		};
+
+		/*! A symbol and whether it has limits in display-math. */
+		using operator_t = std::pair<std::string, bool>;
+
+		/*! A fence (or accent) and whether it stretches. */
+		using accent_t = std::pair<std::string, bool>;
+
+		const std::string function_application = "<mo>&#x2061;</mo>";
+
+		const std::unordered_map<std::string, std::string> identifiers = {
+			{"alpha", "α"}, {"beta", "β"}, {"gamma", "γ"},
+			{"delta", "δ"}, {"epsilon", "ϵ"},
+			{"varepsilon", "ε"}, {"zeta", "ζ"}, {"eta", "η"},
+			{"theta", "θ"}, {"vartheta", "ϑ"}, {"iota", "ι"},
+			{"kappa", "κ"}, {"lambda", "λ"}, {"mu", "μ"},
+			{"nu", "ν"}, {"xi", "ξ"}, {"pi", "π"},
+			{"varpi", "ϖ"}, {"rho", "ρ"}, {"varrho", "ϱ"},
+			{"sigma", "σ"}, {"varsigma", "ς"}, {"tau", "τ"},
+			{"upsilon", "υ"}, {"phi", "ϕ"}, {"varphi", "φ"},
+			{"chi", "χ"}, {"psi", "ψ"}, {"omega", "ω"},
+			{"infty", "∞"}, {"partial", "∂"}, {"nabla", "∇"},
+			{"hbar", "ℏ"}, {"ell", "ℓ"}, {"emptyset", "∅"},
+			{"varnothing", "∅"}, {"aleph", "ℵ"}, {"Re", "ℜ"},
+			{"Im", "ℑ"}, {"wp", "℘"}, {"angle", "∠"},
+			{"triangle", "△"}, {"prime", "′"}, {"top", "⊤"},
+			{"bot", "⊥"}, {"flat", "♭"}, {"natural", "♮"},
+			{"sharp", "♯"}, {"clubsuit", "♣"},
+			{"diamondsuit", "♢"}, {"heartsuit", "♡"},
+			{"spadesuit", "♠"}, {"surd", "√"}, {"imath", "ı"},
+			{"jmath", "ȷ"}
+		};
+
+		/*! Upright (unlike lowercase Greek and Latin letters). */
+		const std::unordered_map<std::string, std::string> upright = {
+			{"Gamma", "Γ"}, {"Delta", "Δ"}, {"Theta", "Θ"},
+			{"Lambda", "Λ"}, {"Xi", "Ξ"}, {"Pi", "Π"},
+			{"Sigma", "Σ"}, {"Upsilon", "Υ"}, {"Phi", "Φ"},
+			{"Psi", "Ψ"}, {"Omega", "Ω"}
+		};
+
+		const std::unordered_map<std::string, std::string> operators = {
+			// Binary operators
+			{"pm", "±"}, {"mp", "∓"}, {"times", "×"},
+			{"div", "÷"}, {"cdot", "⋅"}, {"ast", "∗"},
+			{"star", "⋆"}, {"circ", "∘"}, {"bullet", "∙"},
+			{"diamond", "⋄"}, {"oplus", "⊕"}, {"ominus", "⊖"},
+			{"otimes", "⊗"}, {"oslash", "⊘"}, {"odot", "⊙"},
+			{"circledcirc", "⊚"}, {"boxdot", "⊡"},
+			{"boxplus", "⊞"}, {"boxtimes", "⊠"},
+			{"barwedge", "⊼"}, {"veebar", "⊻"}, {"cap", "∩"},
+			{"cup", "∪"}, {"sqcap", "⊓"}, {"sqcup", "⊔"},
+			{"uplus", "⊎"}, {"wedge", "∧"}, {"land", "∧"},
+			{"vee", "∨"}, {"lor", "∨"}, {"setminus", "∖"},
+			{"wr", "≀"}, {"amalg", "⨿"},
+			{"bigtriangleup", "△"}, {"bigtriangledown", "▽"},
+			{"triangleleft", "◃"}, {"triangleright", "▹"},
+			{"lhd", "⊲"}, {"rhd", "⊳"}, {"dagger", "†"},
+			{"ddagger", "‡"}, {"forall", "∀"}, {"exists", "∃"},
+			{"neg", "¬"}, {"lnot", "¬"},
+
+			// Relations
+			{"leq", "≤"}, {"le", "≤"}, {"geq", "≥"},
+			{"ge", "≥"}, {"neq", "≠"}, {"ne", "≠"},
+			{"equiv", "≡"}, {"approx", "≈"}, {"sim", "∼"},
+			{"simeq", "≃"}, {"cong", "≅"}, {"propto", "∝"},
+			{"ll", "≪"}, {"gg", "≫"}, {"prec", "≺"},
+			{"succ", "≻"}, {"preceq", "⪯"}, {"succeq", "⪰"},
+			{"subset", "⊂"}, {"supset", "⊃"},
+			{"subseteq", "⊆"}, {"supseteq", "⊇"},
+			{"sqsubseteq", "⊑"}, {"sqsupseteq", "⊒"},
+			{"in", "∈"}, {"notin", "∉"}, {"ni", "∋"},
+			{"owns", "∋"}, {"perp", "⊥"}, {"parallel", "∥"},
+			{"mid", "∣"}, {"vdash", "⊢"}, {"dashv", "⊣"},
+			{"models", "⊨"}, {"smile", "⌣"}, {"frown", "⌢"},
+			{"asymp", "≍"}, {"doteq", "≐"}, {"bowtie", "⋈"},
+			{"colon", ":"},
+
+			// Arrows
+			{"gets", "←"}, {"to", "→"}, {"leftarrow", "←"},
+			{"rightarrow", "→"}, {"uparrow", "↑"},
+			{"Uparrow", "⇑"}, {"downarrow", "↓"},
+			{"Downarrow", "⇓"}, {"updownarrow", "↕"},
+			{"Updownarrow", "⇕"}, {"Leftarrow", "⇐"},
+			{"Rightarrow", "⇒"}, {"leftrightarrow", "↔"},
+			{"Leftrightarrow", "⇔"}, {"mapsto", "↦"},
+			{"hookleftarrow", "↩"}, {"hookrightarrow", "↪"},
+			{"leftharpoonup", "↼"}, {"leftharpoondown", "↽"},
+			{"rightharpoonup", "⇀"}, {"rightharpoondown", "⇁"},
+			{"rightleftharpoons", "⇌"}, {"longleftarrow", "⟵"},
+			{"Longleftarrow", "⟸"}, {"longrightarrow", "⟶"},
+			{"Longrightarrow", "⟹"}, {"longleftrightarrow", "⟷"},
+			{"Longleftrightarrow", "⟺"}, {"longmapsto", "⟼"},
+			{"leadsto", "⇝"}, {"nearrow", "↗"},
+			{"searrow", "↘"}, {"swarrow", "↙"},
+			{"nwarrow", "↖"}, {"implies", "⟹"},
+			{"impliedby", "⟸"}, {"iff", "⟺"},
+
+			// Dots
+			{"cdots", "⋯"}, {"ldots", "…"}, {"dots", "…"},
+			{"vdots", "⋮"}, {"ddots", "⋱"}
+		};
+
+		/*! Delimiters, which only stretch after \left, \right or \big. */
+		const std::unordered_map<std::string, std::string> delimiters = {
+			{"{", "{"}, {"}", "}"}, {"|", "‖"}, {"langle", "⟨"},
+			{"rangle", "⟩"}, {"lfloor", "⌊"}, {"rfloor", "⌋"},
+			{"lceil", "⌈"}, {"rceil", "⌉"}, {"vert", "|"},
+			{"Vert", "‖"}, {"lvert", "|"}, {"rvert", "|"},
+			{"lVert", "‖"}, {"rVert", "‖"}, {"backslash", "\\"}
+		};
+
+		const std::unordered_map<std::string, operator_t> large_operators = {
+			{"sum", {"∑", true}}, {"prod", {"∏", true}},
+			{"coprod", {"∐", true}}, {"bigcup", {"⋃", true}},
+			{"bigcap", {"⋂", true}}, {"bigsqcup", {"⨆", true}},
+			{"bigvee", {"⋁", true}}, {"bigwedge", {"⋀", true}},
+			{"bigoplus", {"⨁", true}}, {"bigotimes", {"⨂", true}},
+			{"bigodot", {"⨀", true}}, {"biguplus", {"⨄", true}},
+			{"int", {"∫", false}}, {"iint", {"∬", false}},
+			{"iiint", {"∭", false}}, {"oint", {"∮", false}}
+		};
+
+		const std::unordered_map<std::string, operator_t> functions = {
+			{"arccos", {"arccos", false}}, {"arcsin", {"arcsin", false}},
+			{"arctan", {"arctan", false}}, {"arg", {"arg", false}},
+			{"cos", {"cos", false}}, {"cosh", {"cosh", false}},
+			{"cot", {"cot", false}}, {"coth", {"coth", false}},
+			{"csc", {"csc", false}}, {"deg", {"deg", false}},
+			{"dim", {"dim", false}}, {"exp", {"exp", false}},
+			{"hom", {"hom", false}}, {"ker", {"ker", false}},
+			{"lg", {"lg", false}}, {"ln", {"ln", false}},
+			{"log", {"log", false}}, {"sec", {"sec", false}},
+			{"sin", {"sin", false}}, {"sinh", {"sinh", false}},
+			{"tan", {"tan", false}}, {"tanh", {"tanh", false}},
+			{"det", {"det", true}}, {"gcd", {"gcd", true}},
+			{"inf", {"inf", true}}, {"lim", {"lim", true}},
+			{"liminf", {"lim inf", true}},
+			{"limsup", {"lim sup", true}}, {"max", {"max", true}},
+			{"min", {"min", true}}, {"Pr", {"Pr", true}},
+			{"sup", {"sup", true}}
+		};
+
+		const std::unordered_map<std::string, accent_t> accents = {
+			{"hat", {"^", false}}, {"widehat", {"^", true}},
+			{"check", {"ˇ", false}}, {"tilde", {"~", false}},
+			{"widetilde", {"˜", true}}, {"acute", {"´", false}},
+			{"grave", {"`", false}}, {"dot", {"˙", false}},
+			{"ddot", {"¨", false}}, {"breve", {"˘", false}},
+			{"bar", {"¯", false}}, {"vec", {"→", false}},
+			{"overline", {"¯", true}},
+			{"overrightarrow", {"→", true}},
+			{"overleftarrow", {"←", true}}
+		};
+
+		const std::unordered_map<std::string, std::string> spaces = {
+			{",", "0.1667em"}, {"thinspace", "0.1667em"},
+			{":", "0.2222em"}, {">", "0.2222em"}, {"medspace", "0.2222em"},
+			{";", "0.2778em"}, {"thickspace", "0.2778em"},
+			{"!", "-0.1667em"}, {"negthinspace", "-0.1667em"},
+			{"enspace", "0.5em"}, {"quad", "1em"}, {"qquad", "2em"}
+		};
+
+		const std::unordered_map<std::string, Font> fonts = {
+			{"mathrm", Font::roman}, {"mathit", Font::italic},
+			{"mathbf", Font::bold}, {"boldsymbol", Font::bold_italic},
+			{"bm", Font::bold_italic}, {"mathcal", Font::script},
+			{"mathscr", Font::script}, {"mathfrak", Font::fraktur},
+			{"mathbb", Font::double_struck}, {"mathsf", Font::sans_serif},
+			{"mathtt", Font::monospace}
+		};
+
+		/*! The sizes of \big, \Big, \bigg and \Bigg (as KaTeX's). */
+		const std::unordered_map<std::string, std::string> sizes = {
+			{"big", "1.2em"}, {"Big", "1.8em"},
+			{"bigg", "2.4em"}, {"Bigg", "3em"}
+		};
+
+		/*! The fences around matrix environments. */
+		const std::unordered_map<std::string, std::pair<std::string, std::string>>
+		matrices = {
+			{"matrix", {"", ""}}, {"smallmatrix", {"", ""}},
+			{"pmatrix", {"(", ")"}}, {"bmatrix", {"[", "]"}},
+			{"Bmatrix", {"{", "}"}}, {"vmatrix", {"|", "|"}},
+			{"Vmatrix", {"‖", "‖"}}
+		};
+
+		std::string encode(char32_t code_point)
+		{
+			std::string utf8;
+
+			if (code_point < 0x80)
+			{
+				utf8 += static_cast<char>(code_point);
+			}
+
+			else if (code_point < 0x800)
+			{
+				utf8 += static_cast<char>(0xC0 | (code_point >> 6));
+				utf8 += static_cast<char>(0x80 | (code_point & 0x3F));
+			}
+
+			else if (code_point < 0x10000)
+			{
+				utf8 += static_cast<char>(0xE0 | (code_point >> 12));
+				utf8 += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+				utf8 += static_cast<char>(0x80 | (code_point & 0x3F));
+			}
+
+			else
+			{
+				utf8 += static_cast<char>(0xF0 | (code_point >> 18));
+				utf8 += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+				utf8 += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+				utf8 += static_cast<char>(0x80 | (code_point & 0x3F));
+			}
+
+			return utf8;
+		}
+
+		std::string escape(const std::string& text)
+		{
+			std::string escaped;
+
+			escaped.reserve(text.size());
+
+			for (auto character : text)
+			{
+				switch (character)
+				{
+					case '&': escaped += "&amp;"; break;
+
+					case '<': escaped += "&lt;"; break;
+
+					case '>': escaped += "&gt;"; break;
+
+					default: escaped += character;
+				}
+			}
+
+			return escaped;
+		}
+
+		/*******************************************************************//*!
+		*
+		*	@brief Maps a letter or digit to its Mathematical Alphanumeric
+		*		   Symbol in a font (MathML Core only renders these, not
+		*		   mathvariant, consistently).
+		*
+		*	@return The code point, or 0 if the font has no such symbol.
+		*
+		***********************************************************************/
+
+		char32_t styled(char character, Font font)
+		{
+			// The letters of the Letterlike Symbols block are missing
+			static const std::unordered_map<char, char32_t> holes[] = {
+				{{'h', 0x210E}},
+				{{'B', 0x212C}, {'E', 0x2130}, {'F', 0x2131}, {'H', 0x210B},
+				 {'I', 0x2110}, {'L', 0x2112}, {'M', 0x2133}, {'R', 0x211B},
+				 {'e', 0x212F}, {'g', 0x210A}, {'o', 0x2134}},
+				{{'C', 0x212D}, {'H', 0x210C}, {'I', 0x2111}, {'R', 0x211C},
+				 {'Z', 0x2128}},
+				{{'C', 0x2102}, {'H', 0x210D}, {'N', 0x2115}, {'P', 0x2119},
+				 {'Q', 0x211A}, {'R', 0x211D}, {'Z', 0x2124}}
+			};
+
+			// A, a and 0 of each font (0 = none)
+			char32_t upper = 0, lower = 0, digit = 0;
+
+			const std::unordered_map<char, char32_t>* missing = nullptr;
+
+			switch (font)
+			{
+				case Font::italic:
+					upper = 0x1D434, lower = 0x1D44E, missing = &holes[0];
+					break;
+
+				case Font::bold:
+					upper = 0x1D400, lower = 0x1D41A, digit = 0x1D7CE;
+					break;
+
+				case Font::bold_italic:
+					upper = 0x1D468, lower = 0x1D482, digit = 0x1D7CE;
+					break;
+
+				case Font::script:
+					upper = 0x1D49C, lower = 0x1D4B6, missing = &holes[1];
+					break;
+
+				case Font::fraktur:
+					upper = 0x1D504, lower = 0x1D51E, missing = &holes[2];
+					break;
+
+				case Font::double_struck:
+					upper = 0x1D538, lower = 0x1D552, digit = 0x1D7D8;
+					missing = &holes[3];
+					break;
+
+				case Font::sans_serif:
+					upper = 0x1D5A0, lower = 0x1D5BA, digit = 0x1D7E2;
+					break;
+
+				case Font::monospace:
+					upper = 0x1D670, lower = 0x1D68A, digit = 0x1D7F6;
+					break;
+
+				default: return 0;
+			}
+
+			if (missing)
+			{
+				auto hole = missing->find(character);
+
+				if (hole != missing->end()) return hole->second;
+			}
+
+			if (character >= 'A' && character <= 'Z' && upper)
+			{
+				return upper + (character - 'A');
+			}
+
+			if (character >= 'a' && character <= 'z' && lower)
+			{
+				return lower + (character - 'a');
+			}
+
+			if (character >= '0' && character <= '9' && digit)
+			{
+				return digit + (character - '0');
+			}
+
+			return 0;
+		}
+
+		/*******************************************************************//*!
+		*
+		*	@brief Converts LaTeX to MathML by recursive descent.
+		*
+		*	@details Throws a ParseException for anything it does not
+		*			 support (which includes LaTeX errors), and for groups
+		*			 nested deeper than max_depth, which would otherwise
+		*			 overflow the stack (KaTeX renders those instead).
+		*
+		***********************************************************************/
+
+		class Converter
+		{
+		public:
+
+			/*! How deeply groups, arguments and styles may nest. */
+			static const std::size_t max_depth = 256;
+
+			Converter(const std::string& source, bool display_math)
+			: _source(source)
+			, _position(0)
+			, _depth(0)
+			, _display(display_math)
+			, _font(Font::none)
+			{ }
+
+			std::string convert()
+			{
+				auto mathml = _list();
+
+				if (! _at_end()) _unsupported();
+
+				return mathml;
+			}
+
+		private:
+
+			/*! Counts a level of recursion while in scope. */
+			class Nesting
+			{
+			public:
+
+				explicit Nesting(std::size_t& depth)
+				: _depth(depth)
+				{
+					if (_depth >= max_depth)
+					{
+						throw ParseException("LaTeX nested too deeply!");
+					}
+
+					++_depth;
+				}
+
+				~Nesting()
+				{
+					--_depth;
+				}
+
+			private:
+
+				std::size_t& _depth;
+			};
+
+			[[noreturn]] void _unsupported() const
+			{
+				throw ParseException("Unsupported LaTeX at position " +
+									 std::to_string(_position) + "!");
+			}
+
+			bool _at_end()
+			{
+				_skip_spaces();
+
+				return _position >= _source.size();
+			}
+
+			char _current() const
+			{
+				return _source[_position];
+			}
+
+			void _skip_spaces()
+			{
+				while (_position < _source.size() &&
+					   std::isspace(static_cast<unsigned char>(_current())))
+				{
+					++_position;
+				}
+			}
+
+			void _expect(char character)
+			{
+				if (_at_end() || _current() != character) _unsupported();
+
+				++_position;
+			}
+
+			/*! Returns the name of the command at the position (if any). */
+			std::string _peek_command()
+			{
+				if (_at_end() || _current() != '\\') return "";
+
+				auto start = _position + 1;
+
+				if (start == _source.size()) _unsupported();
+
+				auto end = start;
+
+				while (end < _source.size() &&
+					   std::isalpha(static_cast<unsigned char>(_source[end])))
+				{
+					++end;
+				}
+
+				// Control symbols are a single character
+				if (end == start) ++end;
+
+				return _source.substr(start, end - start);
+			}
+
+			std::string _command()
+			{
+				auto name = _peek_command();
+
+				_position += name.size() + 1;
+
+				return name;
+			}
+
+			/*! Returns the text of a {...} argument, unparsed. */
+			std::string _text()
+			{
+				_expect('{');
+
+				auto start = _position;
+
+				std::size_t depth = 0;
+
+				for (; _position < _source.size(); ++_position)
+				{
+					auto character = _current();
+
+					if (character == '\\' || character == '$') _unsupported();
+
+					if (character == '{') ++depth;
+
+					else if (character == '}' && depth-- == 0) break;
+				}
+
+				if (_position == _source.size()) _unsupported();
+
+				return _source.substr(start, _position++ - start);
+			}
+
+			/*! Converts until the end of the current group (or row). */
+			std::string _list(char stop = '\0')
+			{
+				Nesting nesting(_depth);
+
+				std::string mathml;
+
+				while (! _at_end())
+				{
+					auto character = _current();
+
+					if (character == '}' || character == '&' ||
+						character == stop)
+					{
+						break;
+					}
+
+					auto command = _peek_command();
+
+					if (command == "\\" || command == "end" ||
+						command == "right" || command == "middle")
+					{
+						break;
+					}
+
+					if (command == "displaystyle" || command == "textstyle")
+					{
+						_command();
+
+						auto display = _display;
+
+						_display = command == "displaystyle";
+
+						mathml += "<mstyle displaystyle='";
+
+						mathml += _display ? "true" : "false";
+
+						mathml += "' scriptlevel='0'>" + _list(stop) +
+								  "</mstyle>";
+
+						_display = display;
+
+						break;
+					}
+
+					Node node;
+
+					// A script without a base
+					if (character == '^' || character == '_')
+					{
+						node = {"<mrow></mrow>", false, ""};
+					}
+
+					else node = _atom(false);
+
+					mathml += _scripts(node);
+				}
+
+				return mathml;
+			}
+
+			/*! Converts a {...} group, or a single token, without scripts. */
+			std::string _argument()
+			{
+				if (_at_end()) _unsupported();
+
+				auto node = _atom(true);
+
+				if (node.after.empty()) return node.mathml;
+
+				return "<mrow>" + node.mathml + node.after + "</mrow>";
+			}
+
+			/*! Converts a sub- or superscript. */
+			std::string _script()
+			{
+				auto display = _display;
+
+				_display = false;
+
+				auto mathml = _argument();
+
+				_display = display;
+
+				return mathml;
+			}
+
+			std::string _scripts(Node& node)
+			{
+				std::string subscript, superscript;
+
+				bool has_subscript = false, has_superscript = false;
+
+				std::size_t primes = 0;
+
+				while (! _at_end())
+				{
+					auto character = _current();
+
+					if (character == '\'')
+					{
+						// Primes precede a superscript
+						if (has_superscript) _unsupported();
+
+						++_position;
+
+						superscript += "<mo>′</mo>";
+
+						++primes;
+					}
+
+					else if (character == '^')
+					{
+						if (has_superscript) _unsupported();
+
+						++_position;
+
+						superscript += _script();
+
+						has_superscript = true;
+					}
+
+					else if (character == '_')
+					{
+						if (has_subscript) _unsupported();
+
+						++_position;
+
+						subscript = _script();
+
+						has_subscript = true;
+					}
+
+					else break;
+				}
+
+				has_superscript = ! superscript.empty();
+
+				if (! has_subscript && ! has_superscript)
+				{
+					return node.mathml + node.after;
+				}
+
+				std::string under = node.limits ? "munder" : "msub";
+
+				std::string over = node.limits ? "mover" : "msup";
+
+				std::string both = node.limits ? "munderover" : "msubsup";
+
+				auto& sub = subscript;
+
+				// Scripts are single elements, unless there are primes
+				auto sup = primes && superscript != "<mo>′</mo>" ?
+						   "<mrow>" + superscript + "</mrow>" : superscript;
+
+				std::string mathml;
+
+				if (has_subscript && has_superscript)
+				{
+					mathml = "<" + both + ">" + node.mathml + sub + sup +
+							 "</" + both + ">";
+				}
+
+				else if (has_subscript)
+				{
+					mathml = "<" + under + ">" + node.mathml + sub +
+							 "</" + under + ">";
+				}
+
+				else
+				{
+					mathml = "<" + over + ">" + node.mathml + sup +
+							 "</" + over + ">";
+				}
+
+				return mathml + node.after;
+			}
+
+			Node _atom(bool single)
+			{
+				Nesting nesting(_depth);
+
+				auto character = _current();
+
+				if (character == '{')
+				{
+					++_position;
+
+					auto mathml = _list();
+
+					_expect('}');
+
+					return {"<mrow>" + mathml + "</mrow>", false, ""};
+				}
+
+				if (std::isdigit(static_cast<unsigned char>(character)))
+				{
+					return {_number(single), false, ""};
+				}
+
+				if (std::isalpha(static_cast<unsigned char>(character)))
+				{
+					++_position;
+
+					return {_letter(character), false, ""};
+				}
+
+				if (character == '\\') return _control_sequence();
+
+				++_position;
+
+				switch (character)
+				{
+					case '+': case '=': case ',': case ';': case ':':
+					case '!': case '?': case '.':
+						return {std::string("<mo>") + character + "</mo>",
+								false, ""};
+
+					case '(': case ')': case '[': case ']': case '|':
+					case '/':
+						return {_fence(std::string(1, character)), false, ""};
+
+					case '-': return {"<mo>−</mo>", false, ""};
+
+					case '*': return {"<mo>∗</mo>", false, ""};
+
+					case '<': return {"<mo>&lt;</mo>", false, ""};
+
+					case '>': return {"<mo>&gt;</mo>", false, ""};
+
+					case '\'': return {"<mo>′</mo>", false, ""};
+
+					case '~': return {"<mtext>&#160;</mtext>", false, ""};
+
+					default: --_position; _unsupported();
+				}
+			}
+
+			std::string _number(bool single)
+			{
+				std::string digits(1, _source[_position++]);
+
+				while (! single && _position < _source.size())
+				{
+					auto character = _current();
+
+					auto next = _position + 1 < _source.size() ?
+								_source[_position + 1] : '\0';
+
+					if (std::isdigit(static_cast<unsigned char>(character)) ||
+						(character == '.' &&
+						 std::isdigit(static_cast<unsigned char>(next))))
+					{
+						digits += character;
+
+						++_position;
+					}
+
+					else break;
+				}
+
+				std::string text;
+
+				for (auto digit : digits)
+				{
+					auto code_point = styled(digit, _font);
+
+					text += code_point ? encode(code_point)
+									   : std::string(1, digit);
+				}
+
+				return "<mn>" + text + "</mn>";
+			}
+
+			std::string _letter(char letter)
+			{
+				if (_font == Font::roman)
+				{
+					return std::string("<mi mathvariant='normal'>") +
+						   letter + "</mi>";
+				}
+
+				auto code_point = styled(letter, _font);
+
+				if (code_point) return "<mi>" + encode(code_point) + "</mi>";
+
+				return std::string("<mi>") + letter + "</mi>";
+			}
+
+			std::string _fence(const std::string& fence) const
+			{
+				return "<mo stretchy='false'>" + fence + "</mo>";
+			}
+
+			/*! Reads the delimiter after \left, \right, \middle or \big. */
+			std::string _delimiter()
+			{
+				if (_at_end()) _unsupported();
+
+				auto character = _current();
+
+				if (character == '\\')
+				{
+					auto name = _command();
+
+					auto delimiter = delimiters.find(name);
+
+					if (delimiter != delimiters.end()) return delimiter->second;
+
+					// Vertical arrows stretch, too
+					auto arrow = operators.find(name);
+
+					if (arrow == operators.end() ||
+						name.find("arrow") == std::string::npos)
+					{
+						_unsupported();
+					}
+
+					return arrow->second;
+				}
+
+				++_position;
+
+				switch (character)
+				{
+					case '(': case ')': case '[': case ']': case '|':
+					case '/': case '.':
+						return std::string(1, character);
+
+					case '<': return "⟨";
+
+					case '>': return "⟩";
+
+					default: --_position; _unsupported();
+				}
+			}
+
+			std::string _stretchy(const std::string& delimiter,
+								  const std::string& size = "")
+			{
+				// \left. and \right. are invisible
+				if (delimiter == ".") return "";
+
+				std::string mathml = "<mo fence='true' stretchy='true'";
+
+				if (! size.empty())
+				{
+					mathml += " symmetric='true' minsize='" + size +
+							  "' maxsize='" + size + "'";
+				}
+
+				return mathml + ">" + delimiter + "</mo>";
+			}
+
+			Node _control_sequence()
+			{
+				auto name = _command();
+
+				auto identifier = identifiers.find(name);
+
+				if (identifier != identifiers.end())
+				{
+					return {"<mi>" + identifier->second + "</mi>", false, ""};
+				}
+
+				auto letter = upright.find(name);
+
+				if (letter != upright.end())
+				{
+					return {"<mi mathvariant='normal'>" + letter->second +
+							"</mi>", false, ""};
+				}
+
+				auto symbol = operators.find(name);
+
+				if (symbol != operators.end())
+				{
+					return {"<mo>" + symbol->second + "</mo>", false, ""};
+				}
+
+				auto delimiter = delimiters.find(name);
+
+				if (delimiter != delimiters.end())
+				{
+					return {_fence(delimiter->second), false, ""};
+				}
+
+				auto large = large_operators.find(name);
+
+				if (large != large_operators.end())
+				{
+					return _large_operator(large->second);
+				}
+
+				auto function = functions.find(name);
+
+				if (function != functions.end())
+				{
+					return _function(function->second);
+				}
+
+				auto space = spaces.find(name);
+
+				if (space != spaces.end())
+				{
+					return {"<mspace width='" + space->second + "'/>",
+							false, ""};
+				}
+
+				auto accent = accents.find(name);
+
+				if (accent != accents.end()) return _accent(accent->second);
+
+				auto font = fonts.find(name);
+
+				if (font != fonts.end())
+				{
+					auto outer = _font;
+
+					_font = font->second;
+
+					auto mathml = _argument();
+
+					_font = outer;
+
+					return {mathml, false, ""};
+				}
+
+				if (name == " " || name == "space")
+				{
+					return {"<mtext>&#160;</mtext>", false, ""};
+				}
+
+				if (name == "#" || name == "$" || name == "%" || name == "_")
+				{
+					return {"<mi>" + name + "</mi>", false, ""};
+				}
+
+				if (name == "&") return {"<mo>&amp;</mo>", false, ""};
+
+				if (name == "frac" || name == "dfrac" ||
+					name == "tfrac" || name == "cfrac")
+				{
+					return {_fraction(name, "<mfrac>"), false, ""};
+				}
+
+				if (name == "binom" || name == "dbinom" || name == "tbinom")
+				{
+					auto fraction = _fraction(name, "<mfrac linethickness='0'>");
+
+					return {"<mrow>" + _stretchy("(") + fraction +
+							_stretchy(")") + "</mrow>", false, ""};
+				}
+
+				if (name == "sqrt") return {_root(), false, ""};
+
+				if (name == "left") return {_fenced(), false, ""};
+
+				if (name == "text" || name == "textrm" || name == "mbox" ||
+					name == "textit" || name == "textbf")
+				{
+					return {_mtext(name), false, ""};
+				}
+
+				if (name == "operatorname")
+				{
+					auto text = _text();
+
+					for (auto character : text)
+					{
+						if (! std::isalpha(static_cast<unsigned char>(character)))
+						{
+							_unsupported();
+						}
+					}
+
+					return {"<mi>" + text + "</mi>", false,
+							function_application};
+				}
+
+				if (name == "overset" || name == "stackrel" ||
+					name == "underset")
+				{
+					auto script = _script();
+
+					auto base = _argument();
+
+					auto tag = name == "underset" ? "munder" : "mover";
+
+					return {std::string("<") + tag + ">" + base + script +
+							"</" + tag + ">", false, ""};
+				}
+
+				if (name == "underline")
+				{
+					return {"<munder accentunder='true'>" + _argument() +
+							"<mo stretchy='true'>_</mo></munder>", false, ""};
+				}
+
+				if (name == "overbrace" || name == "underbrace")
+				{
+					auto tag = name == "overbrace" ? "mover" : "munder";
+
+					auto brace = name == "overbrace" ? "⏞" : "⏟";
+
+					return {std::string("<") + tag + ">" + _argument() +
+							"<mo stretchy='true'>" + brace + "</mo></" +
+							tag + ">", true, ""};
+				}
+
+				if (name == "bmod")
+				{
+					return {"<mo lspace='0.2222em' rspace='0.2222em'>mod</mo>",
+							false, ""};
+				}
+
+				if (name == "begin") return {_environment(), false, ""};
+
+				// \big, \Bigl, \biggr, \Biggm etc.
+				auto base = name;
+
+				if (! base.empty() &&
+					(base.back() == 'l' || base.back() == 'r' ||
+					 base.back() == 'm'))
+				{
+					base.pop_back();
+				}
+
+				auto size = sizes.find(base);
+
+				if (size == sizes.end()) size = sizes.find(name);
+
+				if (size != sizes.end())
+				{
+					return {_stretchy(_delimiter(), size->second), false, ""};
+				}
+
+				_unsupported();
+			}
+
+			Node _large_operator(const operator_t& symbol)
+			{
+				bool limits = symbol.second && _display;
+
+				std::string attributes;
+
+				auto modifier = _peek_command();
+
+				if (modifier == "limits" || modifier == "nolimits")
+				{
+					_command();
+
+					limits = modifier == "limits";
+
+					// Not moved beside the operator by the browser
+					if (limits) attributes = " movablelimits='false'";
+				}
+
+				return {"<mo" + attributes + ">" + symbol.first + "</mo>",
+						limits, ""};
+			}
+
+			Node _function(const operator_t& function)
+			{
+				// Multi-letter identifiers are upright
+				return {"<mi>" + function.first + "</mi>",
+						function.second && _display,
+						function_application};
+			}
+
+			Node _accent(const accent_t& accent)
+			{
+				auto base = _argument();
+
+				return {"<mover accent='true'>" + base +
+						"<mo stretchy='" +
+						(accent.second ? "true" : "false") + "'>" +
+						accent.first + "</mo></mover>", false, ""};
+			}
+
+			std::string _fraction(const std::string& name,
+								  const std::string& tag)
+			{
+				auto display = _display;
+
+				// The numerator and denominator are one style smaller
+				_display = name[0] == 'd';
+
+				auto numerator = _argument();
+
+				auto denominator = _argument();
+
+				_display = display;
+
+				auto fraction = tag + numerator + denominator + "</mfrac>";
+
+				if (name[0] == 'd' || name[0] == 'c')
+				{
+					return "<mstyle displaystyle='true' scriptlevel='0'>" +
+						   fraction + "</mstyle>";
+				}
+
+				if (name[0] == 't')
+				{
+					return "<mstyle displaystyle='false' scriptlevel='0'>" +
+						   fraction + "</mstyle>";
+				}
+
+				return fraction;
+			}
+
+			std::string _root()
+			{
+				std::string index;
+
+				bool has_index = ! _at_end() && _current() == '[';
+
+				if (has_index)
+				{
+					++_position;
+
+					index = _list(']');
+
+					_expect(']');
+				}
+
+				auto radicand = _argument();
+
+				if (! has_index) return "<msqrt>" + radicand + "</msqrt>";
+
+				return "<mroot>" + radicand + "<mrow>" + index +
+					   "</mrow></mroot>";
+			}
+
+			/*! Converts \left ... \middle ... \right. */
+			std::string _fenced()
+			{
+				auto mathml = "<mrow>" + _stretchy(_delimiter());
+
+				while (true)
+				{
+					mathml += _list();
+
+					auto command = _peek_command();
+
+					if (command == "middle")
+					{
+						_command();
+
+						mathml += _stretchy(_delimiter());
+					}
+
+					else if (command == "right")
+					{
+						_command();
+
+						break;
+					}
+
+					else _unsupported();
+				}
+
+				return mathml + _stretchy(_delimiter()) + "</mrow>";
+			}
+
+			std::string _mtext(const std::string& name)
+			{
+				std::string text;
+
+				// Spaces in text are significant
+				for (auto character : _text())
+				{
+					if (character == ' ') text += "&#160;";
+
+					else text += escape(std::string(1, character));
+				}
+
+				std::string variant;
+
+				if (name == "textit") variant = " mathvariant='italic'";
+
+				else if (name == "textbf") variant = " mathvariant='bold'";
+
+				return "<mtext" + variant + ">" + text + "</mtext>";
+			}
+
+			std::string _environment()
+			{
+				auto name = _text();
+
+				std::vector<std::string> alignment;
+
+				auto matrix = matrices.find(name);
+
+				if (name == "array")
+				{
+					for (auto column : _text())
+					{
+						switch (column)
+						{
+							case 'l': alignment.push_back("left"); break;
+
+							case 'c': alignment.push_back("center"); break;
+
+							case 'r': alignment.push_back("right"); break;
+
+							case ' ': break;
+
+							default: _unsupported();
+						}
+					}
+				}
+
+				else if (name == "cases") alignment = {"left", "left"};
+
+				else if (name == "aligned") alignment = {"right", "left"};
+
+				else if (name != "gathered" && matrix == matrices.end())
+				{
+					_unsupported();
+				}
+
+				auto display = _display;
+
+				// Cells of aligned and gathered are in display-style
+				_display = name == "aligned" || name == "gathered";
+
+				std::vector<std::vector<std::string>> rows(1);
+
+				while (true)
+				{
+					rows.back().push_back(_list());
+
+					if (_at_end()) _unsupported();
+
+					auto command = _peek_command();
+
+					if (_current() == '&') ++_position;
+
+					else if (command == "\\")
+					{
+						_command();
+
+						// No row spacing (\\[1em])
+						if (! _at_end() && _current() == '[') _unsupported();
+
+						rows.emplace_back();
+					}
+
+					else if (command == "end")
+					{
+						_command();
+
+						if (_text() != name) _unsupported();
+
+						break;
+					}
+
+					else _unsupported();
+				}
+
+				_display = display;
+
+				// A trailing \\ adds no row
+				if (rows.size() > 1 && rows.back().size() == 1 &&
+					rows.back().front().empty())
+				{
+					rows.pop_back();
+				}
+
+				std::string table = "<mtable";
+
+				if (name == "aligned") table += " columnspacing='0em'";
+
+				table += ">";
+
+				for (const auto& row : rows)
+				{
+					table += "<mtr>";
+
+					for (std::size_t column = 0; column < row.size(); ++column)
+					{
+						table += "<mtd";
+
+						if (! alignment.empty())
+						{
+							auto align = name == "aligned" ?
+										 alignment[column % 2] :
+										 alignment[std::min(column,
+															alignment.size() - 1)];
+
+							table += " columnalign='" + align + "'";
+						}
+
+						table += "><mrow>";
+
+						// Keeps the spacing of a relation after &
+						if (name == "aligned" && column % 2) table += "<mi></mi>";
+
+						table += row[column] + "</mrow></mtd>";
+					}
+
+					table += "</mtr>";
+				}
+
+				table += "</mtable>";
+
+				if (name == "smallmatrix")
+				{
+					return "<mstyle scriptlevel='1'>" + table + "</mstyle>";
+				}
+
+				if (name == "cases")
+				{
+					return "<mrow>" + _stretchy("{") + table + "</mrow>";
+				}
+
+				if (matrix != matrices.end() && ! matrix->second.first.empty())
+				{
+					return "<mrow>" + _stretchy(matrix->second.first) + table +
+						   _stretchy(matrix->second.second) + "</mrow>";
+				}
+
+				return table;
+			}
+
+			/*! The LaTeX. */
+			const std::string& _source;
+
+			/*! The index of the next character to convert. */
+			std::size_t _position;
+
+			/*! The current depth of recursion (see Nesting). */
+			std::size_t _depth;
+
+			/*! Whether the current style is display-style. */
+			bool _display;
+
+			/*! The current font (of \mathbb etc.). */
+			Font _font;
+		};
+	}
+
+	const Configurable::settings_t NativeMath::default_settings = {
+		{"all-display-math", "0"},
+		{"throw-on-error", "1"},
+		{"error-color", "#CC0000"},
+		{"log-errors", "1"}
+	};
+
+	const std::string NativeMath::version = "1";
+
+	NativeMath::NativeMath(const factory_t& fallback,
+						   const std::string& fallback_fingerprint,
+						   const Configurable::settings_t& settings)
+	: AbstractMath(settings)
+	, _factory(fallback)
+	, _fallback_fingerprint(fallback_fingerprint)
+	{ }
+
+	std::string NativeMath::render(const std::string& expression,
+								   bool display_math)
+	{
+		std::vector<expression_t> expressions = {{expression, display_math}};
+
+		return render(expressions).front();
+	}
+
+	std::vector<std::string>
+	NativeMath::render(const std::vector<expression_t>& expressions)
+	{
+		auto all_display_math = Configurable::get<bool>("all-display-math");
+
+		std::vector<std::string> html(expressions.size());
+
+		std::vector<expression_t> unsupported;
+
+		std::vector<std::size_t> indices;
+
+		for (std::size_t index = 0; index < expressions.size(); ++index)
+		{
+			const auto& expression = expressions[index];
+
+			std::string mathml;
+
+			if (convert(expression.first,
+						expression.second || all_display_math,
+						mathml))
+			{
+				html[index] = "<span class='math'>\n" + mathml + "</span>\n";
+			}
+
+			else
+			{
+				unsupported.push_back(expression);
+
+				indices.push_back(index);
+			}
+		}
+
+		if (unsupported.empty()) return html;
+
+		if (auto fallback = _fallback_engine())
+		{
+			auto rendered = fallback->render(unsupported);
+
+			for (std::size_t index = 0; index < indices.size(); ++index)
+			{
+				html[indices[index]] = std::move(rendered[index]);
+			}
+		}
+
+		else
+		{
+			for (std::size_t index = 0; index < indices.size(); ++index)
+			{
+				const auto& expression = unsupported[index].first;
+
+				if (Configurable::get<bool>("throw-on-error"))
+				{
+					throw ParseException("Unsupported expression '" +
+										 expression + "'!");
+				}
+
+				html[indices[index]] = _handle_error(expression);
+			}
+		}
+
+		return html;
+	}
+
+	std::string NativeMath::fingerprint() const
+	{
+		return "native-math-" + version + ":" + _fallback_fingerprint;
+	}
+
+	void NativeMath::idle()
+	{
+		if (_fallback) _fallback->idle();
+	}
+
+	bool NativeMath::convert(const std::string& expression,
+							 bool display_math,
+							 std::string& mathml)
+	{
+		std::string body;
+
+		try
+		{
+			body = Converter(expression, display_math).convert();
+		}
+
+		catch (const ParseException&)
+		{
+			return false;
+		}
+
+		mathml = "<math xmlns='http://www.w3.org/1998/Math/MathML'";
+
+		if (display_math) mathml += " display='block'";
+
+		mathml += "><semantics><mrow>" + body + "</mrow>";
+
+		mathml += "<annotation encoding='application/x-tex'>";
+
+		mathml += escape(expression) + "</annotation></semantics></math>";
+
+		return true;
+	}
+
+	AbstractMath* NativeMath::_fallback_engine()
+	{
+		if (! _factory) return nullptr;
+
+		if (! _fallback) _fallback = _factory();
+
+		// The fallback renders like this engine
+		for (const auto& setting : Configurable::settings())
+		{
+			_fallback->configure(setting.first, setting.second);
+		}
+
+		_fallback->deadline(_deadline);
+
+		return _fallback.get();
+	}
+
+	std::string NativeMath::_handle_error(const std::string& expression) const
+	{
+		if (Configurable::get<bool>("log-errors"))
+		{
+			std::clog << "Could not parse expression '"
+					  << expression
+					  << "'!\n";
+		}
+
+		return "<span style='color: " + Configurable::get("error-color") +
+			   "'>" + expression + "</span>";
+	}
+}
@@ -2,21 +2,37 @@
 
 #include "markdown-abstract-markdown.hpp"
 #include "markdown-abstract-math.hpp"
+#include "markdown-asset-cache.hpp"
 #include "markdown-exceptions.hpp"
+#include "markdown-hash.hpp"
+#include "markdown-highlighter.hpp"
+#include "markdown-macros.hpp"
+#include "markdown-mapped-file.hpp"
 #include "markdown-markdown.hpp"
 #include "markdown-math.hpp"
+#include "markdown-native-math.hpp"
+#include "markdown-quickjs-math.hpp"
 
+#include <algorithm>
 #include <boost/filesystem.hpp>
+#include <cctype>
+#include <cstring>
 #include <fstream>
+#include <future>
+#include <istream>
+#include <iterator>
+#include <map>
+#include <ostream>
 #include <regex>
+#include <unordered_map>
 
 namespace Markdown
 {	
-	std::string snippet(const std::string& markdown)
+	std::string snippet(const std::string& markdown, const Deadline& deadline)
 	{
 		Parser parser;
 		
-		return parser.snippet(markdown);
+		return parser.snippet(markdown, deadline);
 	}
 	
 	const Configurable::settings_t Parser::default_settings = {
@@ -25,7 +41,11 @@ namespace Markdown
 		{"markdown-style", "github"},
 		{"code-style", "solarized-dark"},
 		{"include-mode", "network"},
-		{"file-protocol", "0"}
+		{"file-protocol", "0"},
+		{"concurrent-math", "1"},
+		{"highlight-mode", "client"},
+		{"math-engine", "katex"},
+		{"math-macros", ""}
 	};
 	
 	const Parser::tag_t Parser::_link = {
@@ -48,14 +68,19 @@ namespace Markdown
 		"</style>\n"
 	};
 	
+	const std::size_t Parser::_chunk_size = 1 << 16;
+	
+	const Parser::tag_t Parser::_inline_marker = {"\x02", "\x03"};
+	
+	const Parser::tag_t Parser::_display_marker = {"\x02\x02", "\x03"};
+	
 	Parser::Parser(const std::string& root,
 				   const std::string& stylesheet_path,
 				   const Configurable::settings_t& settings)
 	: Configurable(settings)
 	, _root(root)
-	, _markdown(std::make_unique<Markdown>())
-	, _math(std::make_unique<Math>(_join_paths({"katex"})))
 	, _stylesheet(stylesheet_path)
+	, _head_stale(true)
 	{ }
 	
 	Parser::Parser(std::unique_ptr<AbstractMarkdown> markdown_engine,
@@ -68,11 +93,14 @@ namespace Markdown
 	, _math(std::move(math_engine))
 	, _stylesheet(stylesheet_path)
 	, _root(root)
+	, _head_stale(true)
 	{ }
 	
 	Parser::Parser(Parser&& other) noexcept
-	: Parser()
+	: Configurable(settings_t())
+	, _head_stale(true)
 	{
+		// Takes over the engines, without creating any
 		swap(other);
 	}
 	
@@ -81,9 +109,29 @@ namespace Markdown
 		// Enable Argument-Dependent-Lookup (ADL)
 		using std::swap;
 		
+		swap(_settings, other._settings);
+		
+		swap(_root, other._root);
+		
 		swap(_markdown, other._markdown);
 		
 		swap(_math, other._math);
+		
+		swap(_stylesheet, other._stylesheet);
+		
+		swap(_custom_css, other._custom_css);
+		
+		swap(_head_cache, other._head_cache);
+		
+		swap(_head_stale, other._head_stale);
+		
+		swap(_head_assets, other._head_assets);
+		
+		swap(_highlighter, other._highlighter);
+		
+		swap(_macros_preamble, other._macros_preamble);
+		
+		swap(_macros, other._macros);
 	}
 	
 	void swap(Parser& first, Parser& second)
@@ -94,81 +142,233 @@ namespace Markdown
 	Parser::~Parser() = default;
 	
 	
-	std::string Parser::render(std::string markdown)
+	void Parser::configure(const std::string& key, const std::string& value)
 	{
-		std::string html = "<!DOCTYPE html>\n<html>\n<head>\n"
-						   "<!-- Rendered with markdownpp -->\n"
-						   "<meta charset='utf-8'/>\n";
+		auto& setting = Configurable::_get(key);
 		
-		html += _get_stylesheet("katex");
-		
-		auto markdown_style = Configurable::get("markdown-style");
-		
-		if (markdown_style != "none")
+		if (setting != value)
 		{
-			html += _get_stylesheet("themes/markdown/" + markdown_style);
+			setting = value;
+			
+			_head_stale = true;
 		}
+	}
+	
+	std::string& Parser::operator[](const std::string& key)
+	{
+		auto& setting = Configurable::_get(key);
 		
-		if (Configurable::get<bool>("enable-code"))
-		{
-			html += _enable_code();
-		}
+		_head_stale = true;
 		
-		if (! _stylesheet.empty() || ! _custom_css.empty())
-		{
-			html += _add_custom_css();
-		}
+		return setting;
+	}
+	
+	void Parser::settings(const settings_t& settings)
+	{
+		Configurable::settings(settings);
 		
-		html += "</head>\n<body>\n";
-		html += snippet(markdown);
+		_head_stale = true;
+	}
+	
+	std::string Parser::render(std::string markdown, const Deadline& deadline)
+	{
+		const char* data = markdown.data();
+		
+		auto size = markdown.size();
+		
+		auto macros = _front_matter(data, size);
+		
+		std::string html = _head();
+		
+		html += _snippet(data, size, deadline, *macros);
 		html += "</body>\n</html>";
 		
 		return html;
 	}
 	
-	std::string Parser::render_file(const std::string &path)
+	std::string Parser::render_file(const std::string &path,
+									const Deadline& deadline)
 	{
-		auto markdown = _read_file(path);
+		MappedFile file(path);
+		
+		const char* data = file.data();
 		
-		return render(markdown);
+		auto size = file.trimmed_size();
+		
+		auto macros = _front_matter(data, size);
+		
+		std::string html = _head();
+		
+		html += _snippet(data, size, deadline, *macros);
+		html += "</body>\n</html>";
+		
+		return html;
 	}
 	
 	void Parser::render_file(const std::string &path,
-							   const std::string &destination)
+							   const std::string &destination,
+							   const Deadline& deadline)
 	{
-		std::ofstream file(destination, std::ios::trunc);
+		MappedFile file(path);
 		
-		if (! file)
+		std::ofstream output(destination, std::ios::trunc);
+		
+		if (! output)
 		{
-			throw FileException("Could not open file '" + path + "'!");
+			throw FileException("Could not open file '" + destination + "'!");
 		}
 		
-		auto html = render_file(path);
+		const char* data = file.data();
+		
+		auto size = file.trimmed_size();
 		
-		file << html;
+		auto macros = _front_matter(data, size);
+		
+		// As a whole, such that references resolve across the document
+		output << _head();
+		
+		output << _snippet(data, size, deadline, *macros);
+		
+		output << "</body>\n</html>";
+		
+		if (! output)
+		{
+			throw FileException("Could not write file '" + destination + "'!");
+		}
 	}
 	
-	std::string Parser::snippet(std::string markdown) const
+	void Parser::render(std::istream& input,
+						std::ostream& output,
+						const Deadline& deadline)
 	{
-		if (Configurable::get<bool>("enable-math"))
+		static const std::regex list_item("^(?:[-*+]|\\d+[.)])\\s");
+		
+		output << _head() << std::flush;
+		
+		std::string chunk;
+		
+		std::shared_ptr<const Macros> macros;
+		
+		// Front matter (shorter than a chunk) is always in the first one
+		auto render_chunk = [&] {
+			const char* data = chunk.data();
+			
+			auto size = chunk.size();
+			
+			if (! macros) macros = _front_matter(data, size);
+			
+			return _snippet(data, size, deadline, *macros);
+		};
+		
+		std::string line;
+		
+		// The fence character and width of an open fenced code block
+		char fence = '\0';
+		
+		std::size_t fence_width = 0;
+		
+		bool display_math = false;
+		
+		// Whether the last line was blank (i.e. at a block boundary)
+		bool blank = false;
+		
+		while (std::getline(input, line))
 		{
-			auto equations = _extract_math(markdown);
+			auto begin = line.find_first_not_of(" \t");
 			
-			auto html = _markdown->render(markdown);
+			if (begin == std::string::npos)
+			{
+				blank = true;
+			}
 			
-			_convert_math(equations);
+			else
+			{
+				// A new top-level block that is not a list item
+				if (blank &&
+					begin == 0 &&
+					fence == '\0' &&
+					! display_math &&
+					chunk.size() >= _chunk_size &&
+					! std::regex_search(line, list_item))
+				{
+					output << render_chunk() << std::flush;
+					
+					chunk.clear();
+				}
+				
+				blank = false;
+				
+				auto marker = line[begin];
+				
+				auto end = line.find_first_not_of(marker, begin);
+				
+				if (end == std::string::npos) end = line.size();
+				
+				auto width = end - begin;
+				
+				// The info string (trailing whitespace aside)
+				bool info = line.find_first_not_of(" \t\r", end) != std::string::npos;
+				
+				bool fence_line = begin <= 3 &&
+								  (marker == '`' || marker == '~') &&
+								  width >= 3;
+				
+				if (fence != '\0')
+				{
+					// Only a bare run of at least as many markers closes
+					if (fence_line && marker == fence && width >= fence_width && ! info)
+					{
+						fence = '\0';
+					}
+				}
+				
+				// The info string of a backtick fence holds no backticks
+				else if (fence_line &&
+						 (marker == '~' || line.find('`', end) == std::string::npos))
+				{
+					fence = marker;
+					
+					fence_width = width;
+				}
+				
+				else
+				{
+					for (auto math = line.find("$$");
+						 math != std::string::npos;
+						 math = line.find("$$", math + 2))
+					{
+						display_math = ! display_math;
+					}
+				}
+			}
 			
-			_insert_math(html, equations);
+			chunk += line;
 			
-			return html;
+			chunk += '\n';
 		}
 		
-		return _markdown->render(markdown);
+		output << render_chunk();
+		
+		output << "</body>\n</html>" << std::flush;
+	}
+	
+	std::string Parser::snippet(std::string markdown,
+								const Deadline& deadline) const
+	{
+		const char* data = markdown.data();
+		
+		auto size = markdown.size();
+		
+		auto macros = _front_matter(data, size);
+		
+		return _snippet(data, size, deadline, *macros);
 	}
 	
 	void Parser::stylesheet(const std::string& path)
 	{
 		_stylesheet = path;
+		
+		_head_stale = true;
 	}
 	
 	const std::string& Parser::stylesheet() const
@@ -179,12 +379,16 @@ namespace Markdown
 	void Parser::remove_stylesheet()
 	{
 		_stylesheet.clear();
+		
+		_head_stale = true;
 	}
 	
 	
 	void Parser::add_custom_css(const std::string& css)
 	{
 		_custom_css += css;
+		
+		_head_stale = true;
 	}
 	
 	const std::string& Parser::custom_css() const
@@ -195,11 +399,15 @@ namespace Markdown
 	void Parser::clear_custom_css()
 	{
 		_custom_css.clear();
+		
+		_head_stale = true;
 	}
 	
 	void Parser::root(const std::string& root)
 	{
 		_root = root;
+		
+		_head_stale = true;
 	}
 	
 	const std::string& Parser::root() const
@@ -221,49 +429,514 @@ namespace Markdown
 	
 	const AbstractMarkdown& Parser::markdown() const
 	{
-		return *_markdown;
+		return _markdown_engine();
 	}
 	
 	
 	const AbstractMath& Parser::math() const
 	{
-		return *_math;
+		return _math_engine();
 	}
 	
 	AbstractMarkdown& Parser::markdown()
 	{
-		return *_markdown;
+		return _markdown_engine();
 	}
 	
 	
 	AbstractMath& Parser::math()
 	{
+		return _math_engine();
+	}
+	
+	void Parser::idle()
+	{
+		if (_math) _math->idle();
+	}
+	
+	std::string Parser::fingerprint()
+	{
+		Hash hash;
+		
+		auto engine = _math ? std::string() : _math_engine_name();
+		
+		// Without creating a KaTeX engine, which would have these
+		bool katex = engine == "katex" || engine == "quickjs";
+		
+		const auto* default_math_settings = &Math::default_settings;
+		
+#ifdef MARKDOWNPP_QUICKJS
+		if (engine == "quickjs")
+		{
+			default_math_settings = &QuickJSMath::default_settings;
+		}
+#endif
+		
+		const auto& math_settings = katex ? *default_math_settings
+										  : _math_engine().settings();
+		
+		auto math_fingerprint = katex ? Snapshot::katex_hash(_katex_path())
+									  : _math_engine().fingerprint();
+		
+		// Sorted, since the order of an unordered_map is unspecified
+		for (const auto* settings : {&Configurable::settings(),
+									 &_markdown_engine().settings(),
+									 &math_settings})
+		{
+			for (const auto& setting : std::map<std::string, std::string>(
+					 settings->begin(), settings->end()))
+			{
+				hash.update(setting.first).update(setting.second);
+			}
+			
+			hash.update("\n");
+		}
+		
+		hash.update(_root).update(_stylesheet).update(_custom_css);
+		
+		hash.update(math_fingerprint);
+		
+		// The highlighted code depends on highlight.js, not just the head
+		if (Configurable::get<bool>("enable-code") &&
+			_highlight_mode() == "server")
+		{
+			auto path = _join_paths({"themes/code/highlight"});
+			
+			hash.update(Highlighter::fingerprint(path));
+		}
+		
+		hash.update(_head());
+		
+		return hash.hex();
+	}
+	
+	std::vector<std::string> Parser::assets()
+	{
+		_head();
+		
+		std::vector<std::string> paths;
+		
+		for (const auto& asset : _head_assets)
+		{
+			paths.push_back(asset.first);
+		}
+		
+		return paths;
+	}
+	
+	AbstractMarkdown& Parser::_markdown_engine() const
+	{
+		if (! _markdown) _markdown = std::make_unique<Markdown>();
+		
+		return *_markdown;
+	}
+	
+	AbstractMath& Parser::_math_engine() const
+	{
+		if (_math) return *_math;
+		
+		auto katex = _katex_path();
+		
+		if (_math_engine_name() == "native")
+		{
+			// KaTeX only renders what the native engine does not support
+			auto fallback = [katex] {
+				std::unique_ptr<AbstractMath> math = std::make_unique<Math>(katex);
+				
+				return math;
+			};
+			
+			_math = std::make_unique<NativeMath>(fallback,
+												 Snapshot::katex_hash(katex));
+		}
+		
+#ifdef MARKDOWNPP_QUICKJS
+		else if (_math_engine_name() == "quickjs")
+		{
+			_math = std::make_unique<QuickJSMath>(katex);
+		}
+#endif
+		
+		else _math = std::make_unique<Math>(katex);
+		
 		return *_math;
 	}
 	
+	std::string Parser::_katex_path() const
+	{
+		return _join_paths({"katex"});
+	}
+	
 	std::string Parser::_read_file(const std::string &path) const
 	{
-		std::ifstream file(path);
+		MappedFile file(path);
+		
+		return std::string(file.data(), file.trimmed_size());
+	}
+	
+	std::string Parser::_snippet(const char* markdown,
+								 std::size_t size,
+								 const Deadline& deadline,
+								 const Macros& macros) const
+	{
+		std::string html;
+		
+		if (Configurable::get<bool>("enable-math"))
+		{
+			html = _render_with_math(markdown, size, deadline, macros);
+		}
 		
-		if (! file)
+		else
 		{
-			throw FileException("Could not open file '" + path + "'!");
+			deadline.check("rendering markdown");
+			
+			html = _markdown_engine().render(markdown, size);
 		}
 		
-		std::string contents;
+		// Highlighting is optional, so it is the first to go
+		if (Configurable::get<bool>("enable-code") &&
+			Configurable::get("code-style") != "none" &&
+			_highlight_mode() == "server" &&
+			! deadline.expired())
+		{
+			_highlight_code(html);
+		}
 		
-		std::copy(std::istreambuf_iterator<char>{file},
-				  std::istreambuf_iterator<char>{},
-				  std::back_inserter(contents));
+		return html;
+	}
+	
+	std::string Parser::_render_with_math(const char* markdown,
+										  std::size_t size,
+										  const Deadline& deadline,
+										  const Macros& macros) const
+	{
+		std::string substituted;
+		
+		auto equations = _extract_math(markdown, size, substituted);
 		
-		// Strip trailing whitespace
-		auto end = std::find_if_not(contents.rbegin(),
-									contents.rend(),
-									::isspace);
+		deadline.check("rendering markdown");
 		
-		contents.erase(end.base(), contents.end());
+		// Only documents with math need (and create) a math engine
+		if (equations.first.empty() && equations.second.empty())
+		{
+			return _markdown_engine().render(substituted);
+		}
 		
-		return contents;
+		std::string html;
+		
+		if (Configurable::get<bool>("concurrent-math"))
+		{
+			auto& markdown_engine = _markdown_engine();
+			
+			// The math engine stays on this thread (V8 isolates
+			// must not change threads without a v8::Locker)
+			auto rendering = std::async(std::launch::async, [&] {
+				return markdown_engine.render(substituted);
+			});
+			
+			_convert_math(equations, deadline, macros);
+			
+			html = rendering.get();
+		}
+		
+		else
+		{
+			html = _markdown_engine().render(substituted);
+			
+			_convert_math(equations, deadline, macros);
+		}
+		
+		_insert_math(html, equations);
+		
+		return html;
+	}
+	
+	void Parser::_highlight_code(std::string& html) const
+	{
+		static const std::string open = "<pre><code";
+		
+		static const std::string language_attribute = " class=\"language-";
+		
+		static const std::string close = "</code></pre>";
+		
+		std::string result;
+		
+		std::size_t position = 0;
+		
+		for (auto begin = html.find(open);
+			 begin != std::string::npos;
+			 begin = html.find(open, position))
+		{
+			auto content = html.find('>', begin + open.size());
+			
+			auto end = html.find(close, content);
+			
+			if (content == std::string::npos || end == std::string::npos) break;
+			
+			std::string language;
+			
+			auto attributes = begin + open.size();
+			
+			if (html.compare(attributes,
+							 language_attribute.size(),
+							 language_attribute) == 0)
+			{
+				auto first = attributes + language_attribute.size();
+				
+				language = html.substr(first, html.find('"', first) - first);
+			}
+			
+			result.append(html, position, begin - position);
+			
+			auto code = _unescape_html(html.substr(content + 1,
+												   end - content - 1));
+			
+			if (! _highlighter)
+			{
+				auto path = _join_paths({"themes/code/highlight"});
+				
+				_highlighter = std::make_unique<Highlighter>(path);
+			}
+			
+			result += _highlighter->highlight(code, language);
+			
+			position = end + close.size();
+		}
+		
+		if (position == 0) return;
+		
+		result.append(html, position, std::string::npos);
+		
+		html.swap(result);
+	}
+	
+	std::string Parser::_unescape_html(const std::string& escaped)
+	{
+		static const std::vector<std::pair<std::string, char>> entities = {
+			{"&amp;", '&'},
+			{"&lt;", '<'},
+			{"&gt;", '>'},
+			{"&quot;", '"'},
+			{"&#39;", '\''},
+			{"&#47;", '/'}
+		};
+		
+		std::string text;
+		
+		text.reserve(escaped.size());
+		
+		for (std::size_t i = 0; i < escaped.size(); )
+		{
+			auto entity = entities.end();
+			
+			if (escaped[i] == '&')
+			{
+				entity = std::find_if(entities.begin(),
+									  entities.end(),
+									  [&] (const std::pair<std::string, char>& e) {
+					return escaped.compare(i, e.first.size(), e.first) == 0;
+				});
+			}
+			
+			if (entity != entities.end())
+			{
+				text += entity->second;
+				
+				i += entity->first.size();
+			}
+			
+			else text += escaped[i++];
+		}
+		
+		return text;
+	}
+	
+	std::shared_ptr<const Macros> Parser::_front_matter(const char*& markdown,
+														std::size_t& size) const
+	{
+		auto macros = _math_macros();
+		
+		std::size_t position = 0;
+		
+		auto read_line = [&] {
+			auto begin = markdown + position;
+			
+			auto end = static_cast<const char*>(std::memchr(begin, '\n', size - position));
+			
+			std::string line(begin, end ? end : markdown + size);
+			
+			if (! line.empty() && line.back() == '\r') line.pop_back();
+			
+			position = end ? end - markdown + 1 : size;
+			
+			return line;
+		};
+		
+		if (size < 3 || read_line() != "---") return macros;
+		
+		std::string preamble;
+		
+		bool in_macros = false;
+		
+		while (true)
+		{
+			// Never closed, so it was not front matter
+			if (position >= size) return macros;
+			
+			auto line = read_line();
+			
+			if (line == "---" || line == "...") break;
+			
+			auto begin = line.find_first_not_of(" \t");
+			
+			if (begin == std::string::npos) continue;
+			
+			// Continues the last key's value
+			if (begin > 0)
+			{
+				if (in_macros) preamble += line.substr(begin) + '\n';
+				
+				continue;
+			}
+			
+			if (line[0] == '#') continue;
+			
+			auto colon = line.find(':');
+			
+			auto valid = [] (char character) {
+				return std::isalnum(static_cast<unsigned char>(character)) ||
+					   character == '-' ||
+					   character == '_';
+			};
+			
+			if (colon == std::string::npos ||
+				colon == 0 ||
+				! std::all_of(line.begin(), line.begin() + colon, valid) ||
+				(colon + 1 < line.size() &&
+				 line[colon + 1] != ' ' &&
+				 line[colon + 1] != '\t'))
+			{
+				return macros;
+			}
+			
+			in_macros = line.compare(0, colon, "macros") == 0;
+			
+			auto value = line.find_first_not_of(" \t", colon + 1);
+			
+			// Not for a block indicator (| or >)
+			if (in_macros &&
+				value != std::string::npos &&
+				line[value] != '|' &&
+				line[value] != '>')
+			{
+				preamble += line.substr(value) + '\n';
+			}
+		}
+		
+		// Other front matter is left for the markdown engine (e.g. as a rule)
+		if (preamble.empty()) return macros;
+		
+		auto document = std::make_shared<Macros>(*macros);
+		
+		document->define(preamble);
+		
+		markdown += position;
+		
+		size -= position;
+		
+		return document;
+	}
+	
+	std::shared_ptr<const Macros> Parser::_math_macros() const
+	{
+		// Not get(), which would stop at the first space
+		const auto& preamble = Configurable::_get("math-macros");
+		
+		if (! _macros || preamble != _macros_preamble)
+		{
+			_macros = std::make_shared<const Macros>(preamble);
+			
+			_macros_preamble = preamble;
+		}
+		
+		return _macros;
+	}
+	
+	std::string Parser::_highlight_mode() const
+	{
+		auto mode = Configurable::get("highlight-mode");
+		
+		if (mode != "client" && mode != "server")
+		{
+			throw ConfigurationValueException("highlight-mode", mode);
+		}
+		
+		return mode;
+	}
+	
+	std::string Parser::_math_engine_name() const
+	{
+		auto engine = Configurable::get("math-engine");
+		
+		bool valid = engine == "katex" || engine == "native";
+		
+#ifdef MARKDOWNPP_QUICKJS
+		valid |= engine == "quickjs";
+#endif
+		
+		if (! valid)
+		{
+			throw ConfigurationValueException("math-engine", engine);
+		}
+		
+		return engine;
+	}
+	
+	const std::string& Parser::_head()
+	{
+		auto& cache = AssetCache::shared();
+		
+		for (const auto& asset : _head_assets)
+		{
+			if (_head_stale) break;
+			
+			_head_stale = cache.modified(asset.first, asset.second);
+		}
+		
+		if (! _head_stale) return _head_cache;
+		
+		_head_assets.clear();
+		
+		std::string html = "<!DOCTYPE html>\n<html>\n<head>\n"
+						   "<!-- Rendered with markdownpp -->\n"
+						   "<meta charset='utf-8'/>\n";
+		
+		html += _get_stylesheet("katex");
+		
+		auto markdown_style = Configurable::get("markdown-style");
+		
+		if (markdown_style != "none")
+		{
+			html += _get_stylesheet("themes/markdown/" + markdown_style);
+		}
+		
+		if (Configurable::get<bool>("enable-code"))
+		{
+			html += _enable_code();
+		}
+		
+		if (! _stylesheet.empty() || ! _custom_css.empty())
+		{
+			html += _add_custom_css();
+		}
+		
+		html += "</head>\n<body>\n";
+		
+		_head_cache.swap(html);
+		
+		_head_stale = false;
+		
+		return _head_cache;
 	}
 	
 	std::string Parser::_get_stylesheet(const std::string &path) const
@@ -272,9 +945,7 @@ namespace Markdown
 		
 		if (include_mode == "embed")
 		{
-			auto css = _read_file(_join_paths({path, "style.css"}));
-			
-			return _make_tag(_style, css);
+			return _get_asset(_join_paths({path, "style.css"}), _style);
 		}
 		
 		else if(include_mode == "local")
@@ -293,9 +964,7 @@ namespace Markdown
 		
 		else if (include_mode == "network")
 		{
-			auto url = _read_file(_join_paths({path, "network.url"}));
-			
-			return _make_tag(_link, url);
+			return _get_asset(_join_paths({path, "network.url"}), _link);
 		}
 		
 		else throw ConfigurationValueException("include-mode", include_mode);
@@ -307,11 +976,8 @@ namespace Markdown
 		
 		if (include_mode == "embed")
 		{
-			auto raw = _read_file(_join_paths({path, "script.js"}));
-			
-			auto script = _escape_script(raw);
-			
-			return _make_tag(_embedded_script, script);
+			return _get_asset(_join_paths({path, "script.js"}),
+							  _embedded_script);
 		}
 		
 		else if(include_mode == "local")
@@ -330,98 +996,433 @@ namespace Markdown
 		
 		else if (include_mode == "network")
 		{
-			auto url = _read_file(_join_paths({path, "network.url"}));
-			
-			return _make_tag(_external_script, url);
+			return _get_asset(_join_paths({path, "network.url"}),
+							  _external_script);
 		}
 		
 		else throw ConfigurationValueException("include-mode", include_mode);
 	}
+	
+	std::string Parser::_get_asset(const std::string& path,
+								   const tag_t& tag) const
+	{
+		auto loader = [this, &tag] (const std::string& file) {
+			auto contents = _read_file(file);
+			
+			if (&tag == &_embedded_script)
+			{
+				contents = _escape_script(contents);
+			}
+			
+			return _make_tag(tag, contents);
+		};
+		
+		_head_assets.emplace_back(path, tag.first);
+		
+		return AssetCache::shared().get(path, tag.first, loader);
+	}
 
-	Parser::extraction_t Parser::_extract_math(std::string& markdown) const
+	Parser::extraction_t Parser::_extract_math(const char* source,
+											   std::size_t size,
+											   std::string& markdown) const
 	{
-		static const std::string inline_math("(?:^|[^$])\\$([^$]+?)\\$(?!\\$)");
+		extraction_t equations;
+		
+		// The index of each distinct equation, separately for each kind
+		std::unordered_map<std::string, std::size_t> inline_indices;
+		
+		std::unordered_map<std::string, std::size_t> display_indices;
+		
+		// Returns the marker for an equation, adding it if it is new
+		auto intern = [] (equations_t& equations,
+						  std::unordered_map<std::string, std::size_t>& indices,
+						  const char* begin,
+						  const char* end) {
+			auto entry = indices.emplace(std::string(begin, end),
+										 equations.size());
+			
+			if (entry.second) equations.push_back(entry.first->first);
+			
+			return std::to_string(entry.first->second);
+		};
+		
+		// The markers are usually shorter than the equations they replace
+		markdown.reserve(size);
+		
+		// Copies source verbatim, but without any marker characters
+		auto copy = [&] (std::size_t begin, std::size_t end) {
+			std::remove_copy(source + begin,
+							 source + end,
+							 std::back_inserter(markdown),
+							 _inline_marker.first[0]);
+		};
+		
+		// Finds the next $ or ` (or returns size)
+		auto find_delimiter = [&] (std::size_t begin) -> std::size_t {
+			return std::find_if(source + begin, source + size, [] (char c) {
+				return c == '$' || c == '`';
+			}) - source;
+		};
 		
-		static const std::string display_math("\\${2}([^$]+?)\\${2}");
+		std::size_t position = 0;
 		
-		auto inline_matches = _extract(markdown, inline_math);
+		bool line_start = true;
 		
-		auto display_matches = _extract(markdown, display_math);
+		while (position < size)
+		{
+			if (line_start)
+			{
+				auto end = _skip_code_fence(source, size, position);
+				
+				if (end != position)
+				{
+					copy(position, end);
+					
+					// The fence ends at the start of a line (or the end)
+					position = end;
+					
+					continue;
+				}
+			}
+			
+			auto character = source[position];
+			
+			line_start = false;
+			
+			if (character == '\\' && position + 1 < size)
+			{
+				// Escaped characters (e.g. \$ or \`) are never special
+				copy(position, position + 2);
+				
+				position += 2;
+			}
+			
+			else if (character == '`')
+			{
+				auto end = _skip_code_span(source, size, position);
+				
+				copy(position, end);
+				
+				position = end;
+			}
+			
+			else if (character != '$')
+			{
+				if (character != _inline_marker.first[0])
+				{
+					markdown += character;
+				}
+				
+				line_start = (character == '\n');
+				
+				++position;
+			}
+			
+			// Display-math: $$...$$ with no $ or ` in between
+			else if (position + 1 < size && source[position + 1] == '$')
+			{
+				auto begin = position + 2;
+				
+				auto end = find_delimiter(begin);
+				
+				if (end > begin &&
+					end + 1 < size &&
+					source[end] == '$' &&
+					source[end + 1] == '$')
+				{
+					auto marker = intern(equations.second,
+										 display_indices,
+										 source + begin,
+										 source + end);
+					
+					markdown += _make_tag(_display_marker, marker);
+					
+					position = end + 2;
+				}
+				
+				else
+				{
+					markdown += "$$";
+					
+					position = begin;
+				}
+			}
+			
+			// Inline-math: $...$ not followed by another $
+			else
+			{
+				auto begin = position + 1;
+				
+				auto end = find_delimiter(begin);
+				
+				if (end > begin &&
+					end < size &&
+					source[end] == '$' &&
+					(end + 1 == size || source[end + 1] != '$'))
+				{
+					auto marker = intern(equations.first,
+										 inline_indices,
+										 source + begin,
+										 source + end);
+					
+					markdown += _make_tag(_inline_marker, marker);
+					
+					position = end + 1;
+				}
+				
+				else
+				{
+					markdown += '$';
+					
+					position = begin;
+				}
+			}
+		}
 		
-		return {inline_matches, display_matches};
+		return equations;
 	}
 	
-	Parser::equations_t
-	Parser::_extract(std::string &markdown,
-					 const std::string& pattern) const
+	std::size_t Parser::_skip_code_fence(const char* source,
+										 std::size_t size,
+										 std::size_t position) const
 	{
-		equations_t equations;
+		// Returns the first position from begin not holding character
+		auto skip = [&] (std::size_t begin, char character) -> std::size_t {
+			return std::find_if(source + begin, source + size, [=] (char c) {
+				return c != character;
+			}) - source;
+		};
+		
+		// Returns the position of the next newline from begin (or size)
+		auto next_line = [&] (std::size_t begin) -> std::size_t {
+			return std::find(source + begin, source + size, '\n') - source;
+		};
+		
+		auto begin = skip(position, ' ');
+		
+		if (begin == size || begin - position > 3) return position;
+		
+		auto fence = source[begin];
+		
+		if (fence != '`' && fence != '~') return position;
 		
-		std::regex regex_pattern(pattern,
-								 std::regex_constants::ECMAScript |
-								 std::regex_constants::optimize);
+		auto end = skip(begin, fence);
 		
-		std::smatch match;
+		auto width = end - begin;
 		
-		auto begin = markdown.cbegin();
+		if (width < 3) return position;
 		
-		for (std::size_t count = 0;
-			 std::regex_search(begin, markdown.cend(), match, regex_pattern);
-			 ++count)
+		auto info_end = next_line(end);
+		
+		// Not a fence but a code span, e.g. ```x```
+		if (fence == '`' &&
+			std::find(source + end, source + info_end, '`') != source + info_end)
+		{
+			return position;
+		}
+		
+		// Skip the rest of the opening line (the info string)
+		for (auto line = info_end; line < size; )
 		{
-			// Get the actual LaTeX equation
-			equations.push_back(match.str(1));
+			++line;
 			
-			// Offset because match.position is relative to begin
-			auto offset = std::distance(markdown.cbegin(), begin);
+			auto indent = skip(line, ' ');
 			
-			auto marker = std::to_string(count);
+			auto run = skip(indent, fence);
 			
-			markdown.replace(offset + match.position(1),
-							 match.length(1),
-							 marker);
+			auto next = next_line(run);
+			
+			auto trail = std::find_if(source + run, source + next, [] (char c) {
+				return c != ' ' && c != '\t' && c != '\r';
+			});
+			
+			if (indent - line <= 3 &&
+				run - indent >= width &&
+				trail == source + next)
+			{
+				return next == size ? size : next + 1;
+			}
 			
-			// Skip the marker and the trailing $
-			std::advance(begin, match.position(1) + marker.size() + 1);
+			line = next;
 		}
 		
-		return equations;
+		// An unclosed fence extends to the end of the document
+		return size;
 	}
 	
-	void Parser::_convert_math(extraction_t &equations) const
+	std::size_t Parser::_skip_code_span(const char* source,
+										std::size_t size,
+										std::size_t position) const
 	{
+		auto run_end = [&] (std::size_t begin) -> std::size_t {
+			return std::find_if(source + begin, source + size, [] (char c) {
+				return c != '`';
+			}) - source;
+		};
+		
+		auto begin = run_end(position);
+		
+		auto width = begin - position;
+		
+		bool blank = false;
+		
+		for (auto i = begin; i < size; ++i)
+		{
+			if (source[i] == '\n')
+			{
+				// A second newline with only whitespace since the first one
+				if (blank) break;
+				
+				blank = true;
+			}
+			
+			else if (source[i] == '`')
+			{
+				auto end = run_end(i);
+				
+				if (end - i == width) return end;
+				
+				i = end - 1;
+				
+				blank = false;
+			}
+			
+			else if (source[i] != ' ' && source[i] != '\t')
+			{
+				blank = false;
+			}
+		}
+		
+		// Unmatched backticks are literal
+		return begin;
+	}
+	
+	void Parser::_convert_math(extraction_t &equations,
+							   const Deadline& deadline,
+							   const Macros& macros) const
+	{
+		// All at once, such that engines may render them in parallel
+		std::vector<AbstractMath::expression_t> expressions;
+		
+		expressions.reserve(equations.first.size() + equations.second.size());
+		
 		for (auto& equation : equations.first)
 		{
-			equation = _math->render(equation, false);
+			expressions.emplace_back(std::move(equation), false);
 		}
 		
 		for (auto& equation : equations.second)
 		{
-			equation = _math->render(equation, true);
+			expressions.emplace_back(std::move(equation), true);
+		}
+		
+		if (! macros.empty())
+		{
+			for (auto& expression : expressions)
+			{
+				// Left to the engine to report (e.g. a missing argument)
+				try
+				{
+					expression.first = macros.expand(expression.first);
+				}
+				
+				catch (const ParseException&)
+				{ }
+			}
+		}
+		
+		auto& engine = _math_engine();
+		
+		engine.deadline(deadline);
+		
+		std::vector<std::string> html;
+		
+		try
+		{
+			html = engine.render(expressions);
 		}
+		
+		catch (...)
+		{
+			engine.deadline(Deadline());
+			
+			throw;
+		}
+		
+		// Later renders without a deadline must not inherit this one
+		engine.deadline(Deadline());
+		
+		auto next = html.begin();
+		
+		for (auto& equation : equations.first) equation = std::move(*next++);
+		
+		for (auto& equation : equations.second) equation = std::move(*next++);
 	}
 	
 	void Parser::_insert_math(std::string &html, extraction_t &equations) const
 	{
-		// Display-math first (have to rely on first getting rid of
-		// the double $, because if you use a lookbehind to see if
-		// there is another $ for the inline statements, that would
-		// also eat up the character matching (?:^|[^$]), which we
-		// don't want)
-		for (std::size_t i = 0; i < equations.second.size(); ++i)
-		{
-			std::regex pattern("\\${2}" + std::to_string(i) + "\\${2}");
-			
-			html = std::regex_replace(html, pattern, equations.second[i]);
-		}
+		// Repeated equations make the result grow beyond this
+		auto size = html.size();
+		
+		for (const auto& equation : equations.first) size += equation.size();
+		
+		for (const auto& equation : equations.second) size += equation.size();
+		
+		std::string result;
+		
+		result.reserve(size);
 		
-		// Inline-math
-		for (std::size_t i = 0; i < equations.first.size(); ++i)
+		const auto begin = _inline_marker.first[0];
+		
+		const auto end = _inline_marker.second[0];
+		
+		std::size_t position = 0;
+		
+		for (auto marker = html.find(begin);
+			 marker != std::string::npos;
+			 marker = html.find(begin, position))
 		{
-			std::regex pattern("\\$" + std::to_string(i) + "\\$");
+			result.append(html, position, marker - position);
+			
+			position = marker + 1;
+			
+			auto* math = &equations.first;
+			
+			if (position < html.size() && html[position] == begin)
+			{
+				math = &equations.second;
+				
+				++position;
+			}
+			
+			std::size_t index = 0;
+			
+			auto digits = position;
 			
-			html = std::regex_replace(html, pattern, equations.first[i]);
+			for ( ;
+				 digits < html.size() &&
+				 std::isdigit(static_cast<unsigned char>(html[digits]));
+				 ++digits)
+			{
+				index = index * 10 + (html[digits] - '0');
+			}
+			
+			if (digits > position &&
+				digits < html.size() &&
+				html[digits] == end &&
+				index < math->size())
+			{
+				result += (*math)[index];
+				
+				position = digits + 1;
+			}
+			
+			// Not a marker we produced, drop the control character(s)
 		}
+		
+		result.append(html, position, std::string::npos);
+		
+		html.swap(result);
 	}
 	
 	std::string Parser::_enable_code() const
@@ -434,6 +1435,9 @@ namespace Markdown
 		std::replace(code_style.begin(), code_style.end(), '-', '_');
 		
 		auto html = _get_stylesheet("themes/code/style/" + code_style);
+		
+		// The code blocks were highlighted when rendering
+		if (_highlight_mode() == "server") return html;
 			
 		html += _get_script("themes/code/highlight");
 			
@@ -452,9 +1456,7 @@ namespace Markdown
 			
 			if (include_mode == "embed")
 			{
-				auto css = _read_file(_join_paths({_stylesheet}));
-				
-				html += _style.first + css + _style.second;
+				html += _get_asset(_join_paths({_stylesheet}), _style);
 			}
 			
 			else html += _link.first + _stylesheet + _link.second;
@@ -0,0 +1,411 @@
+#ifdef MARKDOWNPP_QUICKJS
+
+#include "markdown-quickjs-math.hpp"
+#include "markdown-exceptions.hpp"
+#include "markdown-hash.hpp"
+#include "markdown-mapped-file.hpp"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace Markdown
+{
+	namespace
+	{
+		/*! The bytecode files (without header) read or written so far. */
+		std::mutex bytecode_mutex;
+
+		std::unordered_map<std::string, std::string> bytecode_files;
+
+		std::string header(const std::string& katex_hash)
+		{
+			return "markdownpp-quickjs\n" + katex_hash + "\n";
+		}
+
+		/*! Polled by QuickJS while running, aborts once the deadline expired. */
+		int interrupt(JSRuntime*, void* opaque)
+		{
+			return static_cast<const AbstractMath*>(opaque)->deadline().expired();
+		}
+
+		/*! Returns the bytecode for a KaTeX version, or an empty string. */
+		std::string load_bytecode(const std::string& path,
+								  const std::string& katex_hash)
+		{
+			std::lock_guard<std::mutex> lock(bytecode_mutex);
+
+			auto entry = bytecode_files.find(path);
+
+			auto expected = header(katex_hash);
+
+			if (entry == bytecode_files.end())
+			{
+				std::string data;
+
+				try
+				{
+					MappedFile file(path);
+
+					data.assign(file.data(), file.size());
+				}
+
+				catch (const FileException&)
+				{
+					return "";
+				}
+
+				entry = bytecode_files.emplace(path, std::move(data)).first;
+			}
+
+			const auto& data = entry->second;
+
+			if (data.size() <= expected.size() ||
+				! std::equal(expected.begin(), expected.end(), data.begin()))
+			{
+				return "";
+			}
+
+			return data.substr(expected.size());
+		}
+
+		void store_bytecode(const std::string& path,
+							const std::string& katex_hash,
+							const std::string& bytecode)
+		{
+			auto data = header(katex_hash) + bytecode;
+
+			// Other threads (or processes) may be storing the same file
+			std::ostringstream temporary;
+
+			temporary << path << "." << ::getpid() << "."
+					  << std::this_thread::get_id() << ".tmp";
+
+			std::ofstream stream(temporary.str(),
+								 std::ios::binary | std::ios::trunc);
+
+			stream.write(data.data(), data.size());
+
+			stream.close();
+
+			if (! stream || std::rename(temporary.str().c_str(), path.c_str()) != 0)
+			{
+				std::remove(temporary.str().c_str());
+			}
+
+			std::lock_guard<std::mutex> lock(bytecode_mutex);
+
+			bytecode_files[path] = std::move(data);
+		}
+	}
+
+	const Configurable::settings_t QuickJSMath::default_settings = {
+		{"all-display-math", "0"},
+		{"throw-on-error", "1"},
+		{"error-color", "#CC0000"},
+		{"log-errors", "1"},
+		{"bytecode", "1"},
+		{"memory-limit", "0"}
+	};
+
+	const std::string QuickJSMath::bytecode_file_name = "katex.qjsbc";
+
+	QuickJSMath::QuickJSMath(const std::string& katex_path,
+							 const Configurable::settings_t& settings)
+	: AbstractMath(settings)
+	, _runtime(JS_NewRuntime())
+	, _context(nullptr)
+	, _render(JS_UNDEFINED)
+	, _options{JS_UNDEFINED, JS_UNDEFINED}
+	, _katex_path(katex_path)
+	{
+		if (! _runtime)
+		{
+			throw FileException("Could not create a QuickJS runtime!");
+		}
+
+		auto limit = Configurable::get<std::size_t>("memory-limit");
+
+		if (limit > 0) JS_SetMemoryLimit(_runtime, limit * 1024 * 1024);
+
+		// QuickJS polls instead of being terminated by the Watchdog
+		JS_SetInterruptHandler(_runtime, interrupt, static_cast<AbstractMath*>(this));
+
+		_context = JS_NewContext(_runtime);
+
+		try
+		{
+			if (! _context)
+			{
+				throw FileException("Could not create a QuickJS context!");
+			}
+
+			_load_katex();
+		}
+
+		catch (...)
+		{
+			if (_context)
+			{
+				for (auto& options : _options) JS_FreeValue(_context, options);
+
+				JS_FreeValue(_context, _render);
+
+				JS_FreeContext(_context);
+			}
+
+			JS_FreeRuntime(_runtime);
+
+			throw;
+		}
+	}
+
+	QuickJSMath::~QuickJSMath()
+	{
+		for (auto& options : _options) JS_FreeValue(_context, options);
+
+		JS_FreeValue(_context, _render);
+
+		JS_FreeContext(_context);
+
+		JS_FreeRuntime(_runtime);
+	}
+
+	std::string QuickJSMath::render(const std::string& expression,
+									bool display_math)
+	{
+		if (_deadline.expired()) return _handle_error(expression);
+
+		display_math |= Configurable::get<bool>("all-display-math");
+
+		JSValue arguments[] = {
+			JS_NewStringLen(_context, expression.data(), expression.size()),
+			_options[display_math]
+		};
+
+		auto value = JS_Call(_context, _render, JS_UNDEFINED, 2, arguments);
+
+		JS_FreeValue(_context, arguments[0]);
+
+		if (JS_IsException(value))
+		{
+			auto what = _exception();
+
+			// Interrupted (an uncatchable InternalError), not a parse error
+			if (_deadline.expired() || ! Configurable::get<bool>("throw-on-error"))
+			{
+				return _handle_error(expression);
+			}
+
+			// Remove the 'ParseError' (redundant)
+			if (what.compare(0, 12, "ParseError: ") == 0) what.erase(0, 12);
+
+			throw ParseException(what);
+		}
+
+		std::size_t size;
+
+		auto string = JS_ToCStringLen(_context, &size, value);
+
+		std::string html(string, size);
+
+		JS_FreeCString(_context, string);
+
+		JS_FreeValue(_context, value);
+
+		return "<span class='math'>\n" + html + "</span>\n";
+	}
+
+	std::string QuickJSMath::fingerprint() const
+	{
+		if (_fingerprint.empty())
+		{
+			auto path = boost::filesystem::path(_katex_path) / "katex.min.js";
+
+			MappedFile katex(path.string());
+
+			_fingerprint = Hash().update(katex.data(), katex.size()).hex();
+		}
+
+		return _fingerprint;
+	}
+
+	void QuickJSMath::idle()
+	{
+		// Reference counting frees everything but cycles
+		JS_RunGC(_runtime);
+	}
+
+	std::size_t QuickJSMath::memory_usage() const
+	{
+		JSMemoryUsage usage;
+
+		JS_ComputeMemoryUsage(_runtime, &usage);
+
+		return static_cast<std::size_t>(usage.malloc_size);
+	}
+
+	const std::string& QuickJSMath::katex_path() const noexcept
+	{
+		return _katex_path;
+	}
+
+	void QuickJSMath::_load_katex()
+	{
+		auto directory = boost::filesystem::path(_katex_path);
+
+		std::string source;
+
+		try
+		{
+			MappedFile katex((directory / "katex.min.js").string());
+
+			// QuickJS wants a null-terminated script
+			source.assign(katex.data(), katex.size());
+		}
+
+		catch (const FileException&)
+		{
+			throw FileException("Could not load katex.min.js!");
+		}
+
+		auto bytecode_path = (directory / bytecode_file_name).string();
+
+		auto use_bytecode = Configurable::get<bool>("bytecode");
+
+		auto katex_hash = fingerprint();
+
+		auto function = JS_EXCEPTION;
+
+		if (use_bytecode)
+		{
+			auto bytecode = load_bytecode(bytecode_path, katex_hash);
+
+			if (! bytecode.empty())
+			{
+				auto data = reinterpret_cast<const uint8_t*>(bytecode.data());
+
+				function = JS_ReadObject(_context,
+										 data,
+										 bytecode.size(),
+										 JS_READ_OBJ_BYTECODE);
+
+				// Rejected (e.g. written by another QuickJS), so replaced
+				if (JS_IsException(function)) _exception();
+			}
+		}
+
+		if (JS_IsException(function))
+		{
+			function = JS_Eval(_context,
+							   source.c_str(),
+							   source.size(),
+							   "katex.min.js",
+							   JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+
+			if (JS_IsException(function))
+			{
+				throw FileException("Could not load katex.min.js: " +
+									_exception());
+			}
+
+			if (use_bytecode)
+			{
+				std::size_t size;
+
+				auto data = JS_WriteObject(_context,
+										   &size,
+										   function,
+										   JS_WRITE_OBJ_BYTECODE);
+
+				if (data)
+				{
+					auto bytes = reinterpret_cast<const char*>(data);
+
+					store_bytecode(bytecode_path,
+								   katex_hash,
+								   std::string(bytes, size));
+
+					js_free(_context, data);
+				}
+			}
+		}
+
+		// Frees the function
+		auto result = JS_EvalFunction(_context, function);
+
+		if (JS_IsException(result))
+		{
+			throw FileException("Could not load katex.min.js: " + _exception());
+		}
+
+		JS_FreeValue(_context, result);
+
+		auto global = JS_GetGlobalObject(_context);
+
+		auto katex = JS_GetPropertyStr(_context, global, "katex");
+
+		_render = JS_GetPropertyStr(_context, katex, "renderToString");
+
+		JS_FreeValue(_context, katex);
+
+		JS_FreeValue(_context, global);
+
+		if (! JS_IsFunction(_context, _render))
+		{
+			throw FileException("Could not load katex.min.js!");
+		}
+
+		for (bool display_math : {false, true})
+		{
+			_options[display_math] = JS_NewObject(_context);
+
+			JS_SetPropertyStr(_context,
+							  _options[display_math],
+							  "displayMode",
+							  JS_NewBool(_context, display_math));
+		}
+	}
+
+	std::string QuickJSMath::_exception() const
+	{
+		auto exception = JS_GetException(_context);
+
+		auto string = JS_ToCString(_context, exception);
+
+		std::string what = string ? string : "";
+
+		JS_FreeCString(_context, string);
+
+		JS_FreeValue(_context, exception);
+
+		return what;
+	}
+
+	std::string QuickJSMath::_handle_error(const std::string &expression) const
+	{
+		if (Configurable::get<bool>("log-errors"))
+		{
+			std::clog << "Could not parse expression '"
+					  << expression
+					  << "'!\n";
+		}
+
+		std::string html = "<span style='color: ";
+
+		html += Configurable::get("error-color");
+
+		html += "'>" + expression + "</span>";
+
+		return html;
+	}
+}
+
+#endif /* MARKDOWNPP_QUICKJS */
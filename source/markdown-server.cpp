@@ -0,0 +1,444 @@
+#include "markdown-server.hpp"
+#include "markdown-abstract-math.hpp"
+#include "markdown-exceptions.hpp"
+#include "markdown-math-cache.hpp"
+#include "markdown-parser.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace Markdown
+{
+	const Configurable::settings_t Server::default_settings = {
+		{"workers", "0"},
+		{"backlog", "64"},
+		{"log", "0"},
+		{"timeout", "0"}
+	};
+
+	const std::size_t Server::latency_window = 1 << 12;
+
+	std::string Server::Statistics::to_string() const
+	{
+		std::ostringstream stream;
+
+		stream << std::fixed << std::setprecision(3)
+			   << "requests: " << requests << "\n"
+			   << "errors: " << errors << "\n"
+			   << "mean: " << mean << " ms\n"
+			   << "median: " << median << " ms\n"
+			   << "p99: " << p99 << " ms\n"
+			   << "maximum: " << maximum << " ms\n";
+
+		return stream.str();
+	}
+
+	Server::Server(const std::string& path,
+				   const factory_t& factory,
+				   const Configurable::settings_t& settings)
+	: Configurable(settings)
+	, _path(path)
+	, _factory(factory)
+	, _finishing(false)
+	, _requests(0)
+	, _errors(0)
+	, _total(0)
+	, _maximum(0)
+	{
+		if (::pipe(_wake) != 0)
+		{
+			throw FileException("Could not create the shutdown pipe!");
+		}
+	}
+
+	Server::~Server()
+	{
+		::close(_wake[0]);
+
+		::close(_wake[1]);
+	}
+
+	void Server::run()
+	{
+		sockaddr_un address;
+
+		if (_path.size() >= sizeof(address.sun_path))
+		{
+			throw FileException("Socket path '" + _path + "' is too long!");
+		}
+
+		std::memset(&address, 0, sizeof(address));
+
+		address.sun_family = AF_UNIX;
+
+		std::strcpy(address.sun_path, _path.c_str());
+
+		// Replace the socket of a server that did not shut down cleanly
+		struct stat status;
+
+		if (::lstat(_path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode))
+		{
+			::unlink(_path.c_str());
+		}
+
+		Connection listener(::socket(AF_UNIX, SOCK_STREAM, 0));
+
+		if (listener.descriptor() < 0 ||
+			::bind(listener.descriptor(),
+				   reinterpret_cast<sockaddr*>(&address),
+				   sizeof(address)) != 0 ||
+			::listen(listener.descriptor(),
+					 Configurable::get<int>("backlog")) != 0)
+		{
+			throw FileException("Could not listen on '" + _path + "'!");
+		}
+
+		auto workers = Configurable::get<std::size_t>("workers");
+
+		if (workers == 0)
+		{
+			workers = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		_finishing = false;
+
+		// Accept connections only once all Parsers are warm
+		std::mutex ready_mutex;
+
+		std::condition_variable all_ready;
+
+		std::size_t ready = 0;
+
+		std::exception_ptr failure;
+
+		auto on_ready = [&] (std::exception_ptr exception) {
+			std::lock_guard<std::mutex> lock(ready_mutex);
+
+			if (exception) failure = exception;
+
+			++ready;
+
+			all_ready.notify_one();
+		};
+
+		std::vector<std::thread> threads;
+
+		for (std::size_t worker = 0; worker < workers; ++worker)
+		{
+			threads.emplace_back(&Server::_work, this, on_ready);
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(ready_mutex);
+
+			all_ready.wait(lock, [&] { return ready == workers; });
+		}
+
+		pollfd descriptors[2] = {
+			{listener.descriptor(), POLLIN, 0},
+			{_wake[0], POLLIN, 0}
+		};
+
+		while (! failure)
+		{
+			if (::poll(descriptors, 2, -1) < 0)
+			{
+				if (errno == EINTR) continue;
+
+				break;
+			}
+
+			if (descriptors[1].revents) break;
+
+			auto descriptor = ::accept(listener.descriptor(), nullptr, nullptr);
+
+			if (descriptor < 0) continue;
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+
+				_connections.emplace_back(descriptor);
+			}
+
+			_queued.notify_one();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			_finishing = true;
+		}
+
+		_queued.notify_all();
+
+		for (auto& thread : threads) thread.join();
+
+		::unlink(_path.c_str());
+
+		if (failure) std::rethrow_exception(failure);
+	}
+
+	void Server::stop() noexcept
+	{
+		char byte = 0;
+
+		// The pipe stays readable, which wakes all pollers
+		auto result = ::write(_wake[1], &byte, 1);
+
+		static_cast<void>(result);
+	}
+
+	Server::Statistics Server::statistics() const
+	{
+		std::vector<double> latencies;
+
+		Statistics statistics;
+
+		{
+			std::lock_guard<std::mutex> lock(_statistics_mutex);
+
+			latencies = _latencies;
+
+			statistics.requests = _requests;
+
+			statistics.errors = _errors;
+
+			statistics.mean = _requests ? _total / _requests : 0;
+
+			statistics.maximum = _maximum;
+		}
+
+		auto percentile = [&latencies] (double fraction) {
+			if (latencies.empty()) return 0.0;
+
+			auto nth = latencies.begin() +
+					   static_cast<std::size_t>(fraction * (latencies.size() - 1));
+
+			std::nth_element(latencies.begin(), nth, latencies.end());
+
+			return *nth;
+		};
+
+		statistics.median = percentile(0.5);
+
+		statistics.p99 = percentile(0.99);
+
+		return statistics;
+	}
+
+	void Server::_work(const std::function<void(std::exception_ptr)>& ready)
+	{
+		std::unique_ptr<Parser> parser;
+
+		try
+		{
+			parser = _factory();
+		}
+
+		catch (...)
+		{
+			ready(std::current_exception());
+
+			return;
+		}
+
+		ready(nullptr);
+
+		while (true)
+		{
+			Connection connection;
+
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+
+				_queued.wait(lock, [this] {
+					return _finishing || ! _connections.empty();
+				});
+
+				// Queued connections are still served when finishing
+				if (_connections.empty()) return;
+
+				connection = std::move(_connections.front());
+
+				_connections.pop_front();
+			}
+
+			try
+			{
+				_serve(*parser, connection);
+			}
+
+			catch (const std::exception&)
+			{
+				// The client went away
+			}
+		}
+	}
+
+	void Server::_serve(Parser& parser, Connection& connection)
+	{
+		pollfd descriptors[2] = {
+			{connection.descriptor(), POLLIN, 0},
+			{_wake[0], POLLIN, 0}
+		};
+
+		Connection::message_t request;
+
+		while (true)
+		{
+			if (::poll(descriptors, 2, -1) < 0)
+			{
+				if (errno == EINTR) continue;
+
+				return;
+			}
+
+			// Requests already sent are served even when stopping
+			if (! (descriptors[0].revents & (POLLIN | POLLHUP))) return;
+
+			if (! connection.receive(request)) return;
+
+			auto start = std::chrono::steady_clock::now();
+
+			auto response = _handle(parser, request);
+
+			std::chrono::duration<double, std::milli> elapsed =
+				std::chrono::steady_clock::now() - start;
+
+			_record(elapsed.count(), response.front() == "ok");
+
+			if (Configurable::get<bool>("log"))
+			{
+				std::ostringstream line;
+
+				line << request.front() << ": " << response.front()
+					 << " in " << elapsed.count() << " ms\n";
+
+				std::clog << line.str();
+			}
+
+			connection.send(response);
+
+			// Off the request's latency, before the next one arrives
+			parser.idle();
+		}
+	}
+
+	Connection::message_t Server::_handle(Parser& parser,
+										  const Connection::message_t& request)
+	{
+		try
+		{
+			if (request.empty())
+			{
+				throw ServerException("Received an empty request!");
+			}
+
+			if (request.front() == "render")
+			{
+				return {"ok", _render(parser, request)};
+			}
+
+			if (request.front() == "statistics")
+			{
+				return {"ok", statistics().to_string() +
+							  MathCache::shared().statistics().to_string()};
+			}
+
+			throw ServerException("Unknown command '" + request.front() + "'!");
+		}
+
+		catch (const std::exception& exception)
+		{
+			return {"error", exception.what()};
+		}
+	}
+
+	std::string Server::_render(Parser& parser,
+								const Connection::message_t& request)
+	{
+		if (request.size() < 2 || request.size() % 2 != 0)
+		{
+			throw ServerException("Received a malformed render request!");
+		}
+
+		const Parser& settings = parser;
+
+		Configurable::settings_t previous;
+
+		auto restore = [&] {
+			for (const auto& setting : previous)
+			{
+				if (settings[setting.first] != setting.second)
+				{
+					parser.configure(setting.first, setting.second);
+				}
+			}
+		};
+
+		try
+		{
+			for (std::size_t i = 2; i < request.size(); i += 2)
+			{
+				const auto& key = request[i];
+
+				// Throws for unknown keys, before anything is changed
+				const auto& value = settings[key];
+
+				previous.emplace(key, value);
+
+				// Reconfiguring invalidates the <head>, so avoid no-ops
+				if (value != request[i + 1]) parser.configure(key, request[i + 1]);
+			}
+
+			auto timeout = Configurable::get<std::size_t>("timeout");
+
+			auto html = timeout ?
+						parser.render(request[1],
+									  Deadline(std::chrono::milliseconds(timeout))) :
+						parser.render(request[1]);
+
+			restore();
+
+			return html;
+		}
+
+		catch (...)
+		{
+			restore();
+
+			throw;
+		}
+	}
+
+	void Server::_record(double milliseconds, bool success)
+	{
+		std::lock_guard<std::mutex> lock(_statistics_mutex);
+
+		if (_latencies.size() < latency_window)
+		{
+			_latencies.push_back(milliseconds);
+		}
+
+		else _latencies[_requests % latency_window] = milliseconds;
+
+		++_requests;
+
+		if (! success) ++_errors;
+
+		_total += milliseconds;
+
+		_maximum = std::max(_maximum, milliseconds);
+	}
+}
@@ -0,0 +1,151 @@
+#include "markdown-snapshot.hpp"
+#include "markdown-asset-cache.hpp"
+#include "markdown-exceptions.hpp"
+#include "markdown-hash.hpp"
+#include "markdown-mapped-file.hpp"
+#include "markdown-v8.hpp"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace Markdown
+{
+	const std::string Snapshot::file_name = "katex.snapshot";
+
+	void Snapshot::create(const std::string& katex_path)
+	{
+		auto directory = boost::filesystem::path(katex_path);
+
+		MappedFile katex((directory / "katex.min.js").string());
+
+		// V8 wants a null-terminated script
+		std::string source(katex.data(), katex.size());
+
+		V8::instance();
+
+		auto blob = v8::V8::CreateSnapshotDataBlob(source.c_str());
+
+		if (! blob.data)
+		{
+			throw FileException("Could not create the V8 snapshot!");
+		}
+
+		auto path = (directory / file_name).string();
+
+		auto temporary = path + ".tmp";
+
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+		file << _header(Hash().update(katex.data(), katex.size()).hex());
+
+		file.write(blob.data, blob.raw_size);
+
+		file.close();
+
+		delete[] blob.data;
+
+		if (! file || std::rename(temporary.c_str(), path.c_str()) != 0)
+		{
+			std::remove(temporary.c_str());
+
+			throw FileException("Could not write file '" + path + "'!");
+		}
+	}
+
+	std::shared_ptr<const Snapshot> Snapshot::load(const std::string& katex_path)
+	{
+		static std::mutex mutex;
+
+		// The KaTeX hash and snapshot last loaded, by directory
+		static std::unordered_map<std::string,
+								  std::pair<std::string,
+											std::shared_ptr<const Snapshot>>> loaded;
+
+		auto directory = boost::filesystem::absolute(katex_path).string();
+
+		std::shared_ptr<const Snapshot> snapshot;
+
+		try
+		{
+			auto hash = katex_hash(directory);
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			auto entry = loaded.find(directory);
+
+			if (entry != loaded.end() && entry->second.first == hash)
+			{
+				return entry->second.second;
+			}
+
+			auto path = boost::filesystem::path(directory) / file_name;
+
+			if (! boost::filesystem::exists(path)) return nullptr;
+
+			MappedFile file(path.string());
+
+			auto header = _header(hash);
+
+			// Missing or stale snapshots are looked for again next time
+			if (file.size() > header.size() &&
+				std::equal(header.begin(), header.end(), file.data()))
+			{
+				snapshot.reset(new Snapshot({file.data() + header.size(),
+											 file.size() - header.size()}));
+
+				loaded[directory] = std::make_pair(hash, snapshot);
+			}
+		}
+
+		catch (const FileException&)
+		{
+			// Fall back to loading katex.min.js (which reports the error)
+			return nullptr;
+		}
+
+		return snapshot;
+	}
+
+	std::string Snapshot::katex_hash(const std::string& katex_path)
+	{
+		auto path = boost::filesystem::path(katex_path) / "katex.min.js";
+
+		// Only hashed again once katex.min.js changed on disk
+		auto loader = [] (const std::string& path) {
+			MappedFile katex(path);
+
+			return Hash().update(katex.data(), katex.size()).hex();
+		};
+
+		return AssetCache::shared().get(path.string(), "katex-hash", loader);
+	}
+
+	v8::StartupData* Snapshot::blob() const noexcept
+	{
+		return &_blob;
+	}
+
+	Snapshot::Snapshot(std::string data)
+	: _data(std::move(data))
+	{
+		_blob.data = _data.data();
+
+		_blob.raw_size = static_cast<int>(_data.size());
+	}
+
+	std::string Snapshot::_header(const std::string& katex_hash)
+	{
+		std::string header = "markdownpp-snapshot\n";
+
+		header += v8::V8::GetVersion();
+
+		header += "\n" + katex_hash + "\n";
+
+		return header;
+	}
+}
@@ -0,0 +1,60 @@
+#include "markdown-v8.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <libplatform/libplatform.h>
+
+namespace Markdown
+{
+	V8& V8::instance()
+	{
+		// Constructed once, on first use (thread-safe since C++11)
+		static V8 v8;
+
+		return v8;
+	}
+
+	V8::V8()
+	: _platform(v8::platform::CreateDefaultPlatform())
+	{
+		v8::V8::InitializeICU();
+
+		v8::V8::InitializePlatform(_platform.get());
+
+		v8::V8::Initialize();
+	}
+
+	V8::~V8()
+	{
+		v8::V8::Dispose();
+
+		v8::V8::ShutdownPlatform();
+	}
+
+	v8::Platform& V8::platform() noexcept
+	{
+		return *_platform;
+	}
+
+	v8::ArrayBuffer::Allocator& V8::allocator() noexcept
+	{
+		return _allocator;
+	}
+
+	void* V8::Allocator::Allocate(std::size_t length)
+	{
+		auto data = AllocateUninitialized(length);
+
+		return data ? std::memset(data, 0, length) : data;
+	}
+
+	void* V8::Allocator::AllocateUninitialized(std::size_t length)
+	{
+		return std::malloc(length);
+	}
+
+	void V8::Allocator::Free(void* data, std::size_t)
+	{
+		std::free(data);
+	}
+}
@@ -0,0 +1,130 @@
+#include "markdown-watchdog.hpp"
+
+#include <algorithm>
+
+namespace Markdown
+{
+	const std::chrono::milliseconds Watchdog::poll_interval(10);
+
+	Watchdog::Guard::Guard(const Deadline& deadline,
+						   const callback_t& callback,
+						   Watchdog& watchdog)
+	: _watchdog(watchdog)
+	, _id(watchdog.watch(deadline, callback))
+	, _released(false)
+	, _fired(false)
+	{ }
+
+	Watchdog::Guard::~Guard()
+	{
+		release();
+	}
+
+	bool Watchdog::Guard::release()
+	{
+		if (! _released)
+		{
+			_fired = _watchdog.unwatch(_id);
+
+			_released = true;
+		}
+
+		return _fired;
+	}
+
+	Watchdog& Watchdog::shared()
+	{
+		static Watchdog watchdog;
+
+		return watchdog;
+	}
+
+	Watchdog::Watchdog()
+	: _next(0)
+	, _stopping(false)
+	{
+		// Started last, once the members are initialized
+		_thread = std::thread(&Watchdog::_run, this);
+	}
+
+	Watchdog::~Watchdog()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			_stopping = true;
+		}
+
+		_changed.notify_one();
+
+		_thread.join();
+	}
+
+	std::size_t Watchdog::watch(const Deadline& deadline,
+								const callback_t& callback)
+	{
+		std::size_t id;
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			id = _next++;
+
+			_watches.emplace(id, Watch{deadline, callback});
+		}
+
+		_changed.notify_one();
+
+		return id;
+	}
+
+	bool Watchdog::unwatch(std::size_t id)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_watches.erase(id);
+
+		return _fired.erase(id) > 0;
+	}
+
+	void Watchdog::_run()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		while (! _stopping)
+		{
+			if (_watches.empty())
+			{
+				_changed.wait(lock);
+
+				continue;
+			}
+
+			auto wake = Deadline::clock_t::now() + poll_interval;
+
+			for (auto watch = _watches.begin(); watch != _watches.end(); )
+			{
+				if (watch->second.deadline.expired())
+				{
+					watch->second.callback();
+
+					_fired.insert(watch->first);
+
+					watch = _watches.erase(watch);
+				}
+
+				else
+				{
+					if (watch->second.deadline.limited())
+					{
+						wake = std::min(wake, watch->second.deadline.time());
+					}
+
+					++watch;
+				}
+			}
+
+			_changed.wait_until(lock, wake);
+		}
+	}
+}
@@ -0,0 +1,229 @@
+#include "markdown-watcher.hpp"
+#include "markdown-exceptions.hpp"
+
+#include <boost/filesystem.hpp>
+#include <cstdint>
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace Markdown
+{
+	namespace
+	{
+		std::string join(const std::string& directory, const std::string& name)
+		{
+			if (directory.empty() || directory.back() == '/')
+			{
+				return directory + name;
+			}
+
+			return directory + "/" + name;
+		}
+	}
+
+#ifdef __linux__
+
+	Watcher::Watcher(std::chrono::milliseconds debounce)
+	: _debounce(debounce)
+	, _descriptor(::inotify_init1(IN_CLOEXEC))
+	{
+		if (_descriptor < 0)
+		{
+			throw FileException("Could not initialize inotify!");
+		}
+	}
+
+	Watcher::~Watcher()
+	{
+		::close(_descriptor);
+	}
+
+	void Watcher::add(const std::string& path)
+	{
+		if (boost::filesystem::is_directory(path))
+		{
+			_watch_recursively(path);
+		}
+
+		else
+		{
+			auto file = boost::filesystem::path(path);
+
+			auto parent = file.parent_path().string();
+
+			_watch(parent.empty() ? "." : parent)
+				.files.insert(file.filename().string());
+		}
+	}
+
+	Watcher::changes_t Watcher::wait()
+	{
+		changes_t changes;
+
+		pollfd descriptor = {_descriptor, POLLIN, 0};
+
+		// Block until something changed, then until things calm down
+		while (changes.empty())
+		{
+			while (::poll(&descriptor, 1, -1) < 0)
+			{
+				if (errno != EINTR)
+				{
+					throw FileException("Could not wait for file changes!");
+				}
+			}
+
+			_read(changes);
+
+			while (::poll(&descriptor, 1, _debounce.count()) > 0)
+			{
+				_read(changes);
+			}
+		}
+
+		return changes;
+	}
+
+	Watcher::Directory& Watcher::_watch(const std::string& path)
+	{
+		static const std::uint32_t mask = IN_CLOSE_WRITE |
+										  IN_MOVED_TO	 |
+										  IN_MOVED_FROM  |
+										  IN_CREATE		 |
+										  IN_DELETE		 |
+										  IN_ONLYDIR;
+
+		auto watch = ::inotify_add_watch(_descriptor, path.c_str(), mask);
+
+		if (watch < 0)
+		{
+			throw FileException("Could not watch '" + path + "'!");
+		}
+
+		// Watching a directory twice yields the same watch descriptor
+		auto entry = _directories.find(watch);
+
+		if (entry == _directories.end())
+		{
+			entry = _directories.emplace(watch, Directory{path, false, {}}).first;
+		}
+
+		return entry->second;
+	}
+
+	void Watcher::_watch_recursively(const std::string& path)
+	{
+		_watch(path).recursive = true;
+
+		boost::system::error_code error;
+
+		for (boost::filesystem::directory_iterator entry(path, error), end;
+			 entry != end;
+			 entry.increment(error))
+		{
+			if (error) break;
+
+			if (boost::filesystem::is_directory(entry->status()))
+			{
+				_watch_recursively(join(path, entry->path().filename().string()));
+			}
+		}
+	}
+
+	void Watcher::_read(changes_t& changes)
+	{
+		alignas(inotify_event) char buffer[1 << 14];
+
+		auto count = ::read(_descriptor, buffer, sizeof(buffer));
+
+		if (count < 0)
+		{
+			if (errno == EINTR || errno == EAGAIN) return;
+
+			throw FileException("Could not read file changes!");
+		}
+
+		for (auto position = buffer; position < buffer + count; )
+		{
+			auto event = reinterpret_cast<const inotify_event*>(position);
+
+			position += sizeof(inotify_event) + event->len;
+
+			auto directory = _directories.find(event->wd);
+
+			if (directory == _directories.end()) continue;
+
+			// The directory itself was removed (or unmounted)
+			if (event->mask & IN_IGNORED)
+			{
+				_directories.erase(directory);
+
+				continue;
+			}
+
+			if (! event->len) continue;
+
+			std::string name(event->name);
+
+			auto path = join(directory->second.path, name);
+
+			if (directory->second.recursive)
+			{
+				if (event->mask & IN_ISDIR)
+				{
+					// Files in new subdirectories are of interest as well
+					if (event->mask & (IN_CREATE | IN_MOVED_TO))
+					{
+						_watch_recursively(path);
+					}
+
+					continue;
+				}
+
+				changes.insert(path);
+			}
+
+			else if (directory->second.files.count(name))
+			{
+				changes.insert(path);
+			}
+		}
+	}
+
+#else
+
+	Watcher::Watcher(std::chrono::milliseconds debounce)
+	: _debounce(debounce)
+	, _descriptor(-1)
+	{
+		throw FileException("Watching files is only supported on Linux!");
+	}
+
+	Watcher::~Watcher() = default;
+
+	void Watcher::add(const std::string&)
+	{ }
+
+	Watcher::changes_t Watcher::wait()
+	{
+		return {};
+	}
+
+	Watcher::Directory& Watcher::_watch(const std::string& path)
+	{
+		return _directories[0] = Directory{path, false, {}};
+	}
+
+	void Watcher::_watch_recursively(const std::string&)
+	{ }
+
+	void Watcher::_read(changes_t&)
+	{ }
+
+#endif
+}
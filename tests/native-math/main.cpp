@@ -0,0 +1,56 @@
+#include "../../include/markdown-native-math.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+	if (! condition)
+	{
+		std::cerr << "FAILED: " << what << "\n";
+
+		++failures;
+	}
+}
+
+std::string nested(std::size_t depth)
+{
+	return std::string(depth, '{') + "x" + std::string(depth, '}');
+}
+
+std::string roots(std::size_t depth)
+{
+	std::string expression;
+
+	for (std::size_t root = 0; root < depth; ++root) expression += "\\sqrt";
+
+	return expression + " x";
+}
+
+int main()
+{
+	std::string mathml;
+
+	check(Markdown::NativeMath::convert(nested(10), false, mathml),
+		  "shallow groups are converted");
+
+	// Left to KaTeX instead of overflowing the stack
+	check(! Markdown::NativeMath::convert(nested(10000), false, mathml),
+		  "deeply nested groups are unsupported");
+
+	check(Markdown::NativeMath::convert(roots(10), false, mathml),
+		  "shallow arguments are converted");
+
+	check(! Markdown::NativeMath::convert(roots(10000), false, mathml),
+		  "deeply nested arguments are unsupported");
+
+	check(! Markdown::NativeMath::convert(nested(10000) + "^2", true, mathml),
+		  "deeply nested scripts are unsupported");
+
+	if (failures == 0) std::cout << "All tests passed\n";
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,202 @@
+#include "../../include/markdown-abstract-markdown.hpp"
+#include "../../include/markdown-abstract-math.hpp"
+#include "../../include/markdown-parser.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+int failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+	if (! condition)
+	{
+		std::cerr << "FAILED: " << what << "\n";
+
+		++failures;
+	}
+}
+
+// Counts the chunks it renders
+class CountingMarkdown : public Markdown::AbstractMarkdown
+{
+public:
+
+	CountingMarkdown(std::size_t& chunks)
+	: AbstractMarkdown({})
+	, _chunks(chunks)
+	{ }
+
+	std::string render(const std::string& markdown) override
+	{
+		++_chunks;
+
+		return markdown;
+	}
+
+	void settings(flags_t) override { }
+
+private:
+
+	std::size_t& _chunks;
+};
+
+// Records the expressions it renders
+class RecordingMath : public Markdown::AbstractMath
+{
+public:
+
+	RecordingMath(std::vector<std::string>& expressions)
+	: AbstractMath({})
+	, _expressions(expressions)
+	{ }
+
+	std::string render(const std::string& expression, bool) override
+	{
+		_expressions.push_back(expression);
+
+		return "<span>" + expression + "</span>";
+	}
+
+private:
+
+	std::vector<std::string>& _expressions;
+};
+
+// Well over two chunks of top-level paragraphs
+std::string paragraphs()
+{
+	std::string markdown;
+
+	while (markdown.size() < (1 << 18))
+	{
+		markdown += "Some words in a paragraph of their own.\n\n";
+	}
+
+	return markdown;
+}
+
+Markdown::Parser parser(std::size_t& chunks, std::vector<std::string>& expressions)
+{
+	Markdown::Parser::settings_t settings = Markdown::Parser::default_settings;
+
+	settings["enable-code"] = "0";
+
+	settings["markdown-style"] = "none";
+
+	return Markdown::Parser(std::make_unique<CountingMarkdown>(chunks),
+							std::make_unique<RecordingMath>(expressions),
+							"../..",
+							std::string(),
+							settings);
+}
+
+// The number of chunks a document is streamed in
+std::size_t chunks(const std::string& markdown)
+{
+	std::size_t chunks = 0;
+
+	std::vector<std::string> expressions;
+
+	auto streaming = parser(chunks, expressions);
+
+	std::istringstream input(markdown);
+
+	std::ostringstream output;
+
+	streaming.render(input, output);
+
+	return chunks;
+}
+
+// The number of chunks a file is rendered to a file in
+std::size_t file_chunks(const std::string& markdown)
+{
+	std::size_t chunks = 0;
+
+	std::vector<std::string> expressions;
+
+	std::ofstream("parser-test.md") << markdown;
+
+	parser(chunks, expressions).render_file("parser-test.md", "parser-test.html");
+
+	std::remove("parser-test.md");
+
+	std::remove("parser-test.html");
+
+	return chunks;
+}
+
+// The markdown the engine is given for a snippet
+std::string markdown(const std::string& snippet)
+{
+	std::size_t chunks = 0;
+
+	std::vector<std::string> expressions;
+
+	return parser(chunks, expressions).snippet(snippet);
+}
+
+// The expressions rendered for a snippet
+std::vector<std::string> expressions(const std::string& markdown)
+{
+	std::size_t chunks = 0;
+
+	std::vector<std::string> expressions;
+
+	parser(chunks, expressions).snippet(markdown);
+
+	return expressions;
+}
+
+int main()
+{
+	check(chunks(paragraphs()) > 1, "paragraphs are split into chunks");
+
+	check(chunks("~\n\n" + paragraphs()) > 1,
+		  "a single tilde does not open a fence");
+
+	check(chunks("``\n\n" + paragraphs()) > 1,
+		  "two backticks do not open a fence");
+
+	check(chunks("```x```\n\n" + paragraphs()) > 1,
+		  "backticks in the info string do not open a fence");
+
+	check(chunks("```\ncode\n```  \n\n" + paragraphs()) > 1,
+		  "a fence closes despite trailing whitespace");
+
+	check(chunks("```\ncode\n``` text\n\n" + paragraphs()) == 1,
+		  "a fence does not close with an info string");
+
+	check(chunks("~~~\ncode\n```\n\n" + paragraphs()) == 1,
+		  "a fence only closes with its own character");
+
+	// Such that reference links and footnotes resolve across the file
+	check(file_chunks(paragraphs()) == 1, "files are rendered as a whole");
+
+	auto math = expressions("```x```\n$a$\n");
+
+	check(math.size() == 1 && math[0] == "a",
+		  "math after backticks with an info string is extracted");
+
+	math = expressions("```\n$a$\n```\n$b$\n");
+
+	check(math.size() == 1 && math[0] == "b",
+		  "math in a code fence is not extracted");
+
+	check(markdown("---\nmacros: \\def\\R{x}\n---\ntext\n") == "text\n",
+		  "front matter with macros is not rendered");
+
+	check(markdown("---\ntitle: x\n---\ntext\n") == "---\ntitle: x\n---\ntext\n",
+		  "front matter without macros is rendered");
+
+	if (failures == 0) std::cout << "All tests passed\n";
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}